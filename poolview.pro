@@ -1,5 +1,5 @@
 TEMPLATE = app
-QT = gui core widgets printsupport serialport webengine webenginecore webenginewidgets
+QT = gui core concurrent sql widgets printsupport serialport webengine webenginecore webenginewidgets
 
 VERSION = 0.6
 
@@ -52,6 +52,12 @@ HEADERS = src/uploadimpl.h \
     src/summaryimpl.h \
     src/graphwidget.h \
     src/datastore.h \
+    src/aggregates.h \
+    src/backup.h \
+    src/binstore.h \
+    src/journal.h \
+    src/sqlstore.h \
+    src/vocabulary.h \
     src/calendar.h \
     src/podbase.h \
     src/podorig.h \
@@ -77,6 +83,12 @@ SOURCES = src/uploadimpl.cpp \
     src/main.cpp \
     src/graphwidget.cpp \
     src/datastore.cpp \
+    src/aggregates.cpp \
+    src/backup.cpp \
+    src/binstore.cpp \
+    src/journal.cpp \
+    src/sqlstore.cpp \
+    src/vocabulary.cpp \
     src/poolmate.c \
     src/calendar.cpp \
     src/podorig.cpp \
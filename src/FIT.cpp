@@ -1005,8 +1005,7 @@ bool FIT::parse(vector<uint8_t> &fitData, std::vector<ExerciseSet> &dst)
                                 INFO ("0x%X", t);
                                 QDateTime timestamp;
                                 timestamp.setTime_t(t + timestampOffset);
-                                e.date = timestamp.date();
-                                e.time = timestamp.time();
+                                e.start = toStart(timestamp);
                                 break;
                             }
                             case 9: { //"Total Distance";
@@ -1014,7 +1013,7 @@ bool FIT::parse(vector<uint8_t> &fitData, std::vector<ExerciseSet> &dst)
                                 break;
                             }
                             case 8: { //Total Timer Time";
-                                e.totalduration = QTime(0, 0).addSecs(*(uint32_t *)ptr / 1000);
+                                e.totalduration = *(uint32_t *)ptr / 1000 * 1000;
                                 break;
                             }
                             case 44: { // Pool length
@@ -1041,7 +1040,7 @@ bool FIT::parse(vector<uint8_t> &fitData, std::vector<ExerciseSet> &dst)
                             }
                             case 7 : { // "Total Elapsed Time";
                                 // duration of the Lap/Set
-                                e.duration = QTime(0, 0).addSecs(*(uint32_t *)ptr / 1000);
+                                e.duration = *(uint32_t *)ptr / 1000 * 1000;
                                 break;
                             }
                             case 32 : { // int lens;
@@ -1155,7 +1154,8 @@ bool FIT::parse(vector<uint8_t> &fitData, std::vector<ExerciseSet> &dst)
                             e.dist = 0;
                             e.strk = 0;
                             // so add the 1 length time to previous lap rest time
-                            e.rest=e.rest.addSecs(e.len_time.back());
+                            if (e.rest >= 0)
+                                e.rest += (int)e.len_time.back() * 1000;
                         } else {
                             // lengths are already added to len_strokes & len_time
                             e.set++;
@@ -1169,7 +1169,7 @@ bool FIT::parse(vector<uint8_t> &fitData, std::vector<ExerciseSet> &dst)
                                 e.strk += *j;
                             }
                             // number of strokes per minute
-                            e.rate = 60 * e.strk / QTime(0,0).secsTo(e.duration);
+                            e.rate = 60 * e.strk / (e.duration / 1000);
                             e.strk /= e.len_strokes.size();
                             
                             // average swolf/efficiency for this lap/set
@@ -1187,7 +1187,7 @@ bool FIT::parse(vector<uint8_t> &fitData, std::vector<ExerciseSet> &dst)
                         e.len_time.clear();
                         e.len_strokes.clear();
                         e.len_style.clear();
-                        e.rest = QTime(0,0);
+                        e.rest = 0;
                         break;
                     }
                     case 101: // length is closed
@@ -1196,7 +1196,8 @@ bool FIT::parse(vector<uint8_t> &fitData, std::vector<ExerciseSet> &dst)
                         
                         if (! e.len_strokes.empty() && e.len_strokes.back() == 0) {
                             // add to lap rest
-                            e.rest=e.rest.addSecs(e.len_time.back());
+                            if (e.rest >= 0)
+                                e.rest += (int)e.len_time.back() * 1000;
                             // remove cur length
                             e.len_strokes.pop_back();
                             e.len_time.pop_back();
@@ -0,0 +1,159 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "aggregates.h"
+#include "datastore.h"
+
+namespace {
+// Only dated swims have anything to add up
+bool counted(const Workout &w)
+{
+    return w.start != NO_START && (w.type == TYPE_SWIM || w.type == TYPE_SWIMHR);
+}
+
+QDate periodEnd(Aggregates::Period period, const QDate &start)
+{
+    switch (period)
+    {
+    case Aggregates::WEEK:
+        return start.addDays(7);
+    case Aggregates::MONTH:
+        return start.addMonths(1);
+    default:
+        return start.addDays(1);
+    }
+}
+
+void addTo(Aggregates::Bucket &b, const Workout &w)
+{
+    if (!b.swims++ || w.min_eff < b.min_eff)
+        b.min_eff = w.min_eff;
+    if (b.swims == 1 || w.max_eff > b.max_eff)
+        b.max_eff = w.max_eff;
+
+    b.dist += w.totaldistance;
+    b.duration += qMax(w.totalduration, 0);
+    b.rest += qMax(w.rest, 0);
+    b.cal += w.cal;
+    b.sum_eff += w.avg_eff;
+}
+
+struct StartLess
+{
+    bool operator()(const Workout &w, qint64 start) const { return w.start < start; }
+};
+
+// Totals of period starting at start, counted from sorted rows
+Aggregates::Bucket count(Aggregates::Period period, const QDate &start, const std::vector<Workout> &rows)
+{
+    const qint64 from = toStart(start, QTime(0, 0));
+    const qint64 to = toStart(periodEnd(period, start), QTime(0, 0));
+
+    Aggregates::Bucket b;
+    std::vector<Workout>::const_iterator i = std::lower_bound(rows.begin(), rows.end(), from, StartLess());
+    for (; i != rows.end() && i->start < to; ++i)
+    {
+        if (counted(*i))
+            addTo(b, *i);
+    }
+    return b;
+}
+} //namespace
+
+QDate Aggregates::periodStart(Period period, const QDate &date)
+{
+    switch (period)
+    {
+    case WEEK:
+        return date.addDays(1 - date.dayOfWeek());
+    case MONTH:
+        return QDate(date.year(), date.month(), 1);
+    default:
+        return date;
+    }
+}
+
+void Aggregates::clear()
+{
+    for (int p = 0; p < PERIODS; ++p)
+        periods[p].clear();
+}
+
+void Aggregates::reset(const std::vector<Workout> &rows)
+{
+    clear();
+    std::vector<Workout>::const_iterator i;
+    for (i = rows.begin(); i != rows.end(); ++i)
+        add(*i);
+}
+
+void Aggregates::add(const Workout &w)
+{
+    if (!counted(w))
+        return;
+
+    const QDate date = startDate(w.start);
+    for (int p = 0; p < PERIODS; ++p)
+        addTo(periods[p][periodStart(Period(p), date)], w);
+}
+
+void Aggregates::remove(const Workout &w)
+{
+    if (!counted(w))
+        return;
+
+    const QDate date = startDate(w.start);
+    for (int p = 0; p < PERIODS; ++p)
+    {
+        Buckets::iterator i = periods[p].find(periodStart(Period(p), date));
+        if (i == periods[p].end())
+            continue;
+
+        Bucket &b = i->second;
+        if (--b.swims <= 0)
+        {
+            periods[p].erase(i);
+            continue;
+        }
+
+        b.dist -= w.totaldistance;
+        b.duration -= qMax(w.totalduration, 0);
+        b.rest -= qMax(w.rest, 0);
+        b.cal -= w.cal;
+        b.sum_eff -= w.avg_eff;
+        if (w.min_eff <= b.min_eff || w.max_eff >= b.max_eff)
+            b.stale = true;
+    }
+}
+
+Aggregates::Buckets Aggregates::range(Period period, const QDate &from, const QDate &to,
+                                      const std::vector<Workout> &rows)
+{
+    Buckets found;
+    Buckets &all = periods[period];
+    Buckets::iterator i;
+    for (i = all.lower_bound(from); i != all.end() && (!to.isValid() || i->first < to); ++i)
+    {
+        if (i->second.stale)
+            i->second = count(period, i->first, rows);
+        found.insert(found.end(), *i);
+    }
+    return found;
+}
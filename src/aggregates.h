@@ -0,0 +1,87 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AGGREGATES_H
+#define AGGREGATES_H
+
+#include <map>
+#include <vector>
+#include <QDate>
+
+struct Workout;
+
+/*
+ * Running totals of the swims in each day, ISO week and month.
+ *
+ * Updated as workouts are added and removed so the summary views look
+ * at one entry per period rather than at every workout. Efficiency
+ * min and max can't be taken back out, so removing the workout that
+ * set one marks its period to be counted again when next asked for.
+ */
+class Aggregates
+{
+public:
+    enum Period
+    {
+        DAY,
+        WEEK,   // starting monday
+        MONTH,
+        PERIODS
+    };
+
+    struct Bucket
+    {
+        Bucket() : swims(0), dist(0), duration(0), rest(0), cal(0),
+                   min_eff(0), max_eff(0), sum_eff(0), stale(false) {}
+
+        int avgEff() const { return swims ? sum_eff / swims : 0; }
+
+        int swims;
+        int dist;
+        qint64 duration; // ms
+        qint64 rest; // ms
+        int cal;
+        int min_eff;
+        int max_eff;
+        qint64 sum_eff;
+        bool stale; // min or max needs counting again
+    };
+
+    // by first day of the period
+    typedef std::map<QDate, Bucket> Buckets;
+
+    // First day of the period holding date
+    static QDate periodStart( Period period, const QDate &date );
+
+    void clear();
+    // Count every workout in rows again
+    void reset( const std::vector<Workout> &rows );
+
+    void add( const Workout &workout );
+    void remove( const Workout &workout );
+
+    // Periods starting in [from, to), an invalid to runs to the last.
+    // Stale ones are counted again from rows, sorted by start.
+    Buckets range( Period period, const QDate &from, const QDate &to,
+                   const std::vector<Workout> &rows );
+
+private:
+    Buckets periods[PERIODS];
+};
+
+#endif
@@ -47,14 +47,15 @@ double AnalysisImpl::getBestTime(int distance)
 {
     double best = -1;
 
-    const std::vector<Workout>& workouts = ds->Workouts();
+    // only swims with a long enough set
+    WorkoutQuery swims = WorkoutQuery::swims();
+    swims.distance = distance;
 
-    for (size_t i = 0; i < workouts.size(); ++i)
+    const WorkoutView workouts = ds->query(swims);
+    WorkoutView::const_iterator i;
+    for (i = workouts.begin(); i != workouts.end(); ++i)
     {
-        const Workout & w = workouts[i];
-
-        if (w.type != "Swim" && w.type != "SwimHR")
-            continue;
+        const Workout & w = *i;
 
         const int pool = w.pool;
 
@@ -75,23 +76,24 @@ double AnalysisImpl::getBestTime(int distance)
             //const int distance = w.pool * numberOfLanes;
             double duration;
 
-            if ((int)set.times.size() != set.lens)
+            if (set.count != set.lens)
             {
                 // Non poolmate live, try to use set duration.
                 // Since we're taking distances >= numberOfLanes which should be slower, assume we can
                 // just divide to get the closes time for shorter distance.
-                duration = (QTime(0,0).secsTo(set.duration) * numberOfLanes / set.lens);
+                duration = (qMax(set.duration, 0) / 1000 * numberOfLanes / set.lens);
             }
             else
             {
                 // Locate fastest window
+                const LengthTable lengths = w.table.decoded();
                 double min = 0.0;
-                for (int j = 0; j <= (int)set.times.size()-numberOfLanes; ++j)
+                for (int j = 0; j <= set.count-numberOfLanes; ++j)
                 {
                     double cur = 0.0;
                     for (int i = j; i < j + numberOfLanes; ++i)
                     {
-                        cur += set.times[i];
+                        cur += lengths.time(set.first + i) / 1000.0;
                     }
                     if (cur < min || min == 0.0)
                         min = cur;
@@ -181,9 +183,10 @@ void AnalysisImpl::precalculate()
     fillTable();
 }
 
-void AnalysisImpl::setDataStore(const DataStore *_ds)
+void AnalysisImpl::setDataStore(DataStore *_ds)
 {
     ds = _ds;
+    ds->loadAll(); // best times over every year
     precalculate();
 }
 
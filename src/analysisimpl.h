@@ -29,7 +29,7 @@ class AnalysisImpl :  public QDialog, private Ui::Analysis
 
 public:
     explicit AnalysisImpl(QWidget *parent = 0);
-    void setDataStore(const DataStore *_ds);
+    void setDataStore(DataStore *_ds);
 
 private slots:
     void on_calcButton_clicked();
@@ -42,7 +42,7 @@ private:
     void fillTable();
     void precalculate();
 
-    const DataStore *ds;
+    DataStore *ds;
 
     std::vector<std::vector<double> > times;
 };
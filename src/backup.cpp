@@ -0,0 +1,235 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QSet>
+
+#include <utility>
+#include <vector>
+
+#include "backup.h"
+
+namespace {
+const char manifest_magic[] = "poolviewer backup 1\n";
+const char backup_prefix[] = "backup-";
+const char chunk_dir[] = "chunks";
+const char stamp_format[] = "yyyy-MM-dd_HH-mm-ss-zzz";
+
+// Chunks are cut between these sizes, about 8k on average
+const int min_chunk = 2*1024;
+const int max_chunk = 64*1024;
+const quint32 cut_mask = 0xfff80000; // top 13 bits of the hash
+
+// Random values for the rolling hash, fixed so cuts are repeatable
+struct Gear
+{
+    Gear()
+    {
+        quint64 x = 0x9e3779b97f4a7c15ULL;
+        for (int i = 0; i < 256; ++i)
+        {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            v[i] = (quint32)(x >> 32);
+        }
+    }
+    quint32 v[256];
+};
+
+const Gear &gear()
+{
+    static const Gear table;
+    return table;
+}
+
+// Length of the chunk starting at p. The hash only covers the last 32
+// bytes, so the same content gives the same cut wherever it is.
+int cut(const uchar *p, qint64 size)
+{
+    if (size <= min_chunk)
+        return size;
+
+    const Gear &g = gear();
+    const int end = size < max_chunk ? size : max_chunk;
+    quint32 h = 0;
+    for (int i = 0; i < end; ++i)
+    {
+        h = (h << 1) + g.v[p[i]];
+        if (i >= min_chunk && !(h & cut_mask))
+            return i + 1;
+    }
+    return end;
+}
+
+// Written alongside then swapped so readers never see part of a file
+bool writeFile(const QString &name, const QByteArray &data)
+{
+    QSaveFile file(name);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size())
+        return false;
+    return file.commit();
+}
+
+typedef std::vector<std::pair<QByteArray, int> > Chunks;
+
+// Hash and length of each chunk in a backup
+bool readManifest(const QString &name, Chunks &chunks)
+{
+    QFile file(name);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    if (file.readLine() != manifest_magic)
+        return false;
+
+    while (!file.atEnd())
+    {
+        const QByteArray line = file.readLine().trimmed();
+        const int space = line.indexOf(' ');
+        if (space <= 0)
+            return false;
+        bool ok;
+        const int len = line.mid(space + 1).toInt(&ok);
+        if (!ok)
+            return false;
+        chunks.push_back(std::make_pair(line.left(space), len));
+    }
+    return true;
+}
+
+// Drop the oldest backups, then chunks nothing uses any more
+void prune(const QString &dir, int keep)
+{
+    QStringList backups = ListBackups(dir);
+    if (keep <= 0 || backups.size() <= keep)
+        return;
+
+    QDir base(dir);
+    while (backups.size() > keep)
+        base.remove(backups.takeFirst());
+
+    QSet<QByteArray> used;
+    for (int i = 0; i < backups.size(); ++i)
+    {
+        Chunks chunks;
+        // a damaged list keeps everything, its chunks can't be told apart
+        if (!readManifest(base.filePath(backups[i]), chunks))
+            return;
+        for (size_t c = 0; c < chunks.size(); ++c)
+            used.insert(chunks[c].first);
+    }
+
+    QDir store(base.filePath(chunk_dir));
+    const QStringList names = store.entryList(QDir::Files);
+    for (int i = 0; i < names.size(); ++i)
+    {
+        if (!used.contains(names[i].toLatin1()))
+            store.remove(names[i]);
+    }
+}
+} //namespace
+
+bool BackupFile( const QString & file, const QString & dir, int keep )
+{
+    QFile in(file);
+    if (!in.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray data = in.readAll();
+    in.close();
+
+    QDir base(dir);
+    if (!base.mkpath(chunk_dir))
+        return false;
+
+    QByteArray manifest(manifest_magic);
+    const uchar *p = (const uchar*)data.constData();
+    const qint64 size = data.size();
+    for (qint64 pos = 0; pos < size; )
+    {
+        const int len = cut(p + pos, size - pos);
+        const QByteArray chunk = QByteArray::fromRawData(data.constData() + pos, len);
+        const QByteArray hash = QCryptographicHash::hash(chunk, QCryptographicHash::Sha1).toHex();
+
+        // unchanged chunks are already there from an earlier backup
+        const QString name = base.filePath(QString("%1/%2").arg(chunk_dir).arg(QString::fromLatin1(hash)));
+        if (!QFile::exists(name) && !writeFile(name, qCompress(chunk)))
+            return false;
+
+        manifest += hash + ' ' + QByteArray::number(len) + '\n';
+        pos += len;
+    }
+
+    // names sort oldest first
+    const QString stamp = QDateTime::currentDateTime().toString(stamp_format);
+    if (!writeFile(base.filePath(backup_prefix + stamp), manifest))
+        return false;
+
+    prune(dir, keep);
+    return true;
+}
+
+QStringList ListBackups( const QString & dir )
+{
+    QStringList filter;
+    filter << QString("%1*").arg(backup_prefix);
+
+    QStringList names = QDir(dir).entryList(filter, QDir::Files, QDir::Name);
+    // skip any left part written, backup names have no dot
+    for (int i = names.size() - 1; i >= 0; --i)
+    {
+        if (names[i].contains('.'))
+            names.removeAt(i);
+    }
+    return names;
+}
+
+QDateTime LastBackup( const QString & dir )
+{
+    const QStringList names = ListBackups(dir);
+    if (names.isEmpty())
+        return QDateTime();
+    return QDateTime::fromString(names.last().mid(sizeof(backup_prefix) - 1), stamp_format);
+}
+
+bool RestoreBackup( const QString & dir, const QString & backup, const QString & file )
+{
+    QDir base(dir);
+    Chunks chunks;
+    if (!readManifest(base.filePath(backup), chunks))
+        return false;
+
+    QByteArray data;
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        QFile in(base.filePath(QString("%1/%2").arg(chunk_dir).arg(QString::fromLatin1(chunks[i].first))));
+        if (!in.open(QIODevice::ReadOnly))
+            return false;
+
+        const QByteArray chunk = qUncompress(in.readAll());
+        if (chunk.size() != chunks[i].second ||
+            QCryptographicHash::hash(chunk, QCryptographicHash::Sha1).toHex() != chunks[i].first)
+            return false;
+        data += chunk;
+    }
+    return writeFile(file, data);
+}
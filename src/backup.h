@@ -0,0 +1,48 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BACKUP_H
+#define BACKUP_H
+
+#include <QDateTime>
+#include <QString>
+#include <QStringList>
+
+/*
+ * Deduplicated backups of the data file.
+ *
+ * Files are cut into chunks where the content says so rather than at
+ * fixed offsets, so an insert only changes the chunks around it. Each
+ * chunk is stored once, compressed and named by its hash, and a backup
+ * is just the list of its chunks. Saving a backup only writes the
+ * chunks that changed since the last one.
+ */
+
+// Back up file into dir, then drop all but the newest keep backups
+bool BackupFile( const QString & file, const QString & dir, int keep );
+
+// Names of the backups in dir, oldest first
+QStringList ListBackups( const QString & dir );
+
+// When the newest backup in dir was taken, invalid if there are none
+QDateTime LastBackup( const QString & dir );
+
+// Rebuild file as it was in backup
+bool RestoreBackup( const QString & dir, const QString & backup, const QString & file );
+
+#endif
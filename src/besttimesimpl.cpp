@@ -28,25 +28,26 @@ namespace
         QTime duration(0, 0);
         double range = 0.0; // time range per length: slowest - fastest
 
-        if ((int)set.times.size() != set.lens)
+        if (set.count != set.lens)
         {
             // Non poolmate live, try to use set duration.
             // Since we're taking distances >= numberOfLanes which should be slower, assume we can
             // just divide to get the closes time for shorter distance.
-            duration = duration.addMSecs( (QTime(0,0).msecsTo(set.duration) * numberOfLanes / set.lens ));
+            duration = duration.addMSecs( (qMax(set.duration, 0) * numberOfLanes / set.lens ));
         }
         else
         {
             // Locate fastest window
+            const LengthTable lengths = workout.table.decoded();
             double min = 0.0;
-            for (int j = 0; j <= (int)set.times.size()-numberOfLanes; ++j)
+            for (int j = 0; j <= set.count-numberOfLanes; ++j)
             {
                 double cur = 0.0;
                 double fastest = std::numeric_limits<double>::max();
                 double slowest = -fastest;
                 for (int i = j; i < j + numberOfLanes; ++i)
                 {
-                    const double time = set.times[i];
+                    const double time = lengths.time(set.first + i) / 1000.0;
                     fastest = std::min(fastest, time);
                     slowest = std::max(slowest, time);
                     cur += time;
@@ -66,10 +67,10 @@ namespace
         const int row = table->rowCount();
         table->setRowCount(row + 1);
 
-        QTableWidgetItem * dateItem = createTableWidgetItem(QVariant(workout.date));
+        QTableWidgetItem * dateItem = createTableWidgetItem(QVariant(startDate(workout.start)));
         table->setItem(row, 0, dateItem);
 
-        QTableWidgetItem * timeItem = createTableWidgetItem(QVariant(workout.time));
+        QTableWidgetItem * timeItem = createTableWidgetItem(QVariant(startTime(workout.start)));
         table->setItem(row, 1, timeItem);
 
         QTableWidgetItem * poolItem = createTableWidgetItem(QVariant(workout.pool));
@@ -114,7 +115,7 @@ BestTimesImpl::BestTimesImpl(QWidget *parent) :
     timesTable->sortItems(5);
 }
 
-void BestTimesImpl::setDataStore(const DataStore *_ds)
+void BestTimesImpl::setDataStore(DataStore *_ds)
 {
     ds = _ds;
 }
@@ -149,56 +150,64 @@ void BestTimesImpl::on_calculateButton_clicked()
 
     double bestSpeed = std::numeric_limits<double>::max();
 
-    const std::vector<Workout>& workouts = ds->Workouts();
+    // Period as a range of start times
+    QDate first, last;
+    switch(id)
+    {
+    case ALL:
+        break;
 
-    for (size_t i = 0; i < workouts.size(); ++i)
+    case THISMONTH:
     {
-        const Workout & w = workouts[i];
+        QDate now = QDate::currentDate();
+        first = QDate(now.year(), now.month(), 1);
+        last = first.addMonths(1);
+        break;
+    }
 
-        switch(id)
-        {
-        case ALL:
-            break;
+    case THISYEAR:
+    {
+        QDate now = QDate::currentDate();
+        first = QDate(now.year(), 1, 1);
+        last = first.addYears(1);
+        break;
+    }
 
-        case THISMONTH:
-        {
-            QDate now = QDate::currentDate();
-            if (w.date.month() != now.month() ||
-                    w.date.year() != now.year())
-                continue;
-            break;
-        }
+    case LASTMONTH:
+    {
+        QDate then = QDate::currentDate().addMonths(-1);
+        first = QDate(then.year(), then.month(), 1);
+        last = first.addMonths(1);
+        break;
+    }
 
-        case THISYEAR:
-        {
-            QDate now = QDate::currentDate();
-            if (w.date.year() != now.year())
-                continue;
-            break;
-        }
+    case LASTYEAR:
+    {
+        QDate then = QDate::currentDate().addYears(-1);
+        first = QDate(then.year(), 1, 1);
+        last = first.addYears(1);
+        break;
+    }
+    }
 
-        case LASTMONTH:
-        {
-            QDate then = QDate::currentDate().addMonths(-1);
-            if (w.date.month() != then.month() ||
-                    w.date.year() != then.year())
-                continue;
-            break;
-        }
+    qint64 from = NO_START;
+    qint64 to = std::numeric_limits<qint64>::max();
+    if (first.isValid())
+    {
+        from = toStart(first, QTime(0, 0));
+        to = toStart(last, QTime(0, 0));
+    }
 
-        case LASTYEAR:
-        {
-            QDate then = QDate::currentDate().addYears(-1);
-            if (w.date.year() != then.year())
-                continue;
-            break;
-        }
-        }
+    // older years are only read when asked for, ALL needs them all
+    ds->loadFrom(first);
 
-        if (w.type != "Swim" && w.type != "SwimHR")
-        {
-            continue;
-        }
+    const std::vector<Workout>& workouts = ds->Workouts();
+
+    // only swims with a long enough set
+    const std::vector<int> rows = ds->findSwims(from, to, distance);
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        const Workout & w = workouts[rows[i]];
 
         const int pool = w.pool;
 
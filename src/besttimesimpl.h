@@ -30,7 +30,7 @@ class BestTimesImpl : public QDialog, private Ui::besttimesimpl
 public:
     explicit BestTimesImpl(QWidget *parent = 0);
 
-    void setDataStore(const DataStore *_ds);
+    void setDataStore(DataStore *_ds);
 
 private slots:
     void on_calculateButton_clicked();
@@ -38,7 +38,7 @@ private slots:
     void on_progressionBox_clicked();
 
 private:
-    const DataStore *ds;
+    DataStore *ds;
 };
 
 #endif // BESTTIMESIMPL_H
@@ -0,0 +1,662 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCache>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QSaveFile>
+#include <QtEndian>
+
+#include <string.h>
+#include <algorithm>
+
+#include "binstore.h"
+#include "datastore.h"
+
+namespace
+{
+const char store_magic[4] = { 'P', 'V', 'D', 'S' };
+const quint32 store_version = 1;
+
+const quint32 header_size = 52;
+const quint32 workout_size = 64;
+const quint32 set_size = 56;
+
+void put_u16(QByteArray &array, quint16 value)
+{
+    uchar b[2];
+    qToLittleEndian(value, b);
+    array.append((const char*)b, 2);
+}
+
+void put_u32(QByteArray &array, quint32 value)
+{
+    uchar b[4];
+    qToLittleEndian(value, b);
+    array.append((const char*)b, 4);
+}
+
+void put_i32(QByteArray &array, qint32 value)
+{
+    put_u32(array, (quint32)value);
+}
+
+void put_u64(QByteArray &array, quint64 value)
+{
+    uchar b[8];
+    qToLittleEndian(value, b);
+    array.append((const char*)b, 8);
+}
+
+void put_f64(QByteArray &array, double value)
+{
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uchar b[8];
+    qToLittleEndian(bits, b);
+    array.append((const char*)b, 8);
+}
+
+// Pad record out to its fixed size
+void pad_to(QByteArray &array, int start, quint32 size)
+{
+    while ((quint32)(array.size() - start) < size)
+        array.append('\0');
+}
+
+// Start is stored as julian day and ms into the day, 0 day marks no start.
+// Durations are ms with -1 for unset, same as in memory.
+qint32 start_day(qint64 start)
+{
+    return start == NO_START ? 0 : (qint32)(epoch_day + startDay(start));
+}
+
+qint32 start_ms(qint64 start)
+{
+    return start == NO_START ? -1 : (qint32)(start - startDay(start) * 86400) * 1000;
+}
+
+qint64 to_start(qint32 jd, qint32 ms)
+{
+    if (!jd)
+        return NO_START;
+    return (jd - epoch_day) * 86400 + (ms < 0 ? 0 : ms / 1000);
+}
+
+// Build a table of distinct strings
+class StringTable
+{
+public:
+    quint16 index(const QString &str)
+    {
+        QHash<QString, quint16>::const_iterator i = lookup.constFind(str);
+        if (i != lookup.constEnd())
+            return i.value();
+
+        quint16 id = strings.size();
+        lookup.insert(str, id);
+        strings.push_back(str);
+        return id;
+    }
+
+    std::vector<QString> strings;
+
+private:
+    QHash<QString, quint16> lookup;
+};
+
+// Bounds checked cursor over the mapped file
+class Cursor
+{
+public:
+    Cursor(const uchar *_data, qint64 _size) : data(_data), size(_size), pos(0), ok(true) {}
+
+    bool need(qint64 n)
+    {
+        if (pos + n > size)
+            ok = false;
+        return ok;
+    }
+
+    const uchar *take(qint64 n)
+    {
+        if (!need(n))
+            return 0;
+        const uchar *p = data + pos;
+        pos += n;
+        return p;
+    }
+
+    const uchar *data;
+    qint64 size;
+    qint64 pos;
+    bool ok;
+};
+
+quint16 get_u16(const uchar *p) { return qFromLittleEndian<quint16>(p); }
+quint32 get_u32(const uchar *p) { return qFromLittleEndian<quint32>(p); }
+quint64 get_u64(const uchar *p) { return qFromLittleEndian<quint64>(p); }
+qint32 get_i32(const uchar *p) { return (qint32)qFromLittleEndian<quint32>(p); }
+
+// Vocabulary codes of file strings, looked up on first use
+class CodeTable
+{
+public:
+    CodeTable(Vocabulary &_vocab, const std::vector<QString> &_strings)
+        : vocab(&_vocab), strings(&_strings), codes(_strings.size(), -1) {}
+
+    int code(const uchar *p)
+    {
+        const quint16 id = get_u16(p);
+        if (id >= codes.size())
+            return 0;
+        if (codes[id] < 0)
+            codes[id] = vocab->code((*strings)[id]);
+        return codes[id];
+    }
+
+private:
+    Vocabulary *vocab;
+    const std::vector<QString> *strings;
+    std::vector<int> codes;
+};
+
+double get_f64(const uchar *p)
+{
+    quint64 bits = qFromLittleEndian<quint64>(p);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Length columns of a file
+struct Columns
+{
+    const uchar *times;
+    const uchar *strokes;
+    const uchar *styles;
+};
+
+// Append a set's lengths to block, time and style index the columns
+void decodeLengths(const Columns &c, quint32 time, quint32 tcount, quint32 style, quint32 scount,
+                   CodeTable &style_codes, LengthBlock &block)
+{
+    for (quint32 l = 0; l < tcount; ++l, ++time)
+    {
+        block.append(qRound(get_f64(c.times + (qint64)time * 8) * 1000),
+                     get_i32(c.strokes + (qint64)time * 4),
+                     l < scount ? style_codes.code(c.styles + (qint64)(style + l) * 2) : 0);
+    }
+}
+
+// Most recently used lengths kept decoded, in lengths
+const int lazy_cache = 64*1024;
+
+// Keeps the file mapped and decodes a workout's lengths when asked
+class StoreLengths : public LengthSource
+{
+public:
+    StoreLengths(const QString &name)
+        : file(name), data(0), size(0), mapped(false), style_codes(strokeStyles(), strings),
+          stable(0), ssize(0), cache(lazy_cache)
+    {
+        if (!file.open(QIODevice::ReadOnly))
+            return;
+
+        size = file.size();
+        data = file.map(0, size);
+        mapped = data != 0;
+        if (!mapped)
+        {
+            // mapping not supported, keep a copy instead
+            copy = file.readAll();
+            file.close();
+            data = (const uchar*)copy.constData();
+            size = copy.size();
+        }
+    }
+
+    ~StoreLengths()
+    {
+        if (mapped)
+            file.unmap((uchar*)data);
+    }
+
+    // Tables point into data
+    void setTables(const std::vector<QString> &_strings, const uchar *_stable, quint32 _ssize,
+                   const Columns &_columns)
+    {
+        strings = _strings;
+        style_codes = CodeTable(strokeStyles(), strings);
+        stable = _stable;
+        ssize = _ssize;
+        columns = _columns;
+    }
+
+    QFile file;
+    const uchar *data;
+    qint64 size;
+
+    // Where each workout's sets and lengths start
+    struct Span
+    {
+        quint32 set;
+        quint32 sets;
+        quint32 time;
+        quint32 style;
+    };
+    std::vector<Span> spans;
+
+    QExplicitlySharedDataPointer<LengthBlock> lengths(int n)
+    {
+        typedef QExplicitlySharedDataPointer<LengthBlock> Block;
+
+        QMutexLocker locker(&lock);
+        Block *cached = cache.object(n);
+        if (cached)
+            return *cached;
+
+        // offsets were checked when the file was read
+        const Span &span = spans[n];
+        Block block(new LengthBlock);
+        quint32 time = span.time;
+        quint32 style = span.style;
+        for (quint32 s = span.set; s < span.set + span.sets; ++s)
+        {
+            const uchar *sr = stable + (qint64)s * ssize;
+            const quint32 tcount = get_u32(sr+44);
+            const quint32 scount = get_u32(sr+48);
+            decodeLengths(columns, time, tcount, style, scount, style_codes, *block);
+            time += tcount;
+            style += scount;
+        }
+
+        cache.insert(n, new Block(block), qMax<int>(block->times.size(), 1));
+        return block;
+    }
+
+private:
+    bool mapped;
+    QByteArray copy;
+    std::vector<QString> strings;
+    CodeTable style_codes;
+    const uchar *stable;
+    quint32 ssize;
+    Columns columns;
+
+    QMutex lock;
+    QCache<int, QExplicitlySharedDataPointer<LengthBlock> > cache;
+};
+
+// With source set lengths are left undecoded in it, data must be its data
+bool decode(const uchar *data, qint64 size, std::vector<Workout>& dst, quint64 *sequence,
+            StoreLengths *source = 0)
+{
+    Cursor in(data, size);
+
+    const uchar *h = in.take(header_size);
+    if (!h || memcmp(h, store_magic, 4) != 0)
+        return false;
+
+    const quint32 version = get_u32(h+4);
+    const quint32 hsize   = get_u32(h+8);
+    const quint32 wsize   = get_u32(h+12);
+    const quint32 ssize   = get_u32(h+16);
+    const quint32 nstrings  = get_u32(h+20);
+    const quint32 nworkouts = get_u32(h+24);
+    const quint32 nsets     = get_u32(h+28);
+    const quint32 ntimes    = get_u32(h+32);
+    const quint32 nstyles   = get_u32(h+36);
+
+    if (version > store_version || hsize < header_size ||
+        wsize < workout_size || ssize < set_size)
+        return false;
+
+    in.take(hsize - header_size);
+    if (!in.ok)
+        return false;
+
+    if (sequence)
+        *sequence = get_u64(h+40);
+
+    std::vector<QString> strings;
+    strings.reserve(nstrings);
+    for (quint32 n = 0; n < nstrings && in.ok; ++n)
+    {
+        const uchar *p = in.take(2);
+        if (!p)
+            break;
+        quint16 len = get_u16(p);
+        const uchar *s = in.take(len);
+        if (!s)
+            break;
+        strings.push_back(QString::fromUtf8((const char*)s, len));
+    }
+
+    const uchar *wtable = in.take((qint64)nworkouts * wsize);
+    const uchar *stable = in.take((qint64)nsets * ssize);
+    const uchar *times  = in.take((qint64)ntimes * 8);
+    const uchar *strokes = in.take((qint64)ntimes * 4);
+    const uchar *styles = in.take((qint64)nstyles * 2);
+    if (!in.ok)
+        return false;
+
+    CodeTable types(workoutTypes(), strings);
+    CodeTable units(poolUnits(), strings);
+    CodeTable style_codes(strokeStyles(), strings);
+    const Columns columns = { times, strokes, styles };
+
+    if (source)
+    {
+        source->setTables(strings, stable, ssize, columns);
+        source->spans.reserve(nworkouts);
+    }
+
+    quint32 set = 0;
+    quint32 time = 0;
+    quint32 style = 0;
+
+    // lengths of every workout go in one block
+    QExplicitlySharedDataPointer<LengthBlock> block(new LengthBlock);
+    if (!source)
+        block->reserve(ntimes);
+
+    dst.reserve(dst.size() + nworkouts);
+    for (quint32 n = 0; n < nworkouts; ++n)
+    {
+        const uchar *r = wtable + (qint64)n * wsize;
+        const quint32 base = time;
+        const quint32 first_set = set;
+        const quint32 first_style = style;
+
+        Workout wrk;
+        wrk.id = get_i32(r);
+        wrk.user = get_i32(r+4);
+        wrk.start = to_start(get_i32(r+8), get_i32(r+12));
+        wrk.type = types.code(r+16);
+        wrk.unit = units.code(r+18);
+        wrk.pool = get_i32(r+20);
+        wrk.totalduration = get_i32(r+24);
+        wrk.rest = get_i32(r+28);
+        wrk.max_eff = get_i32(r+32);
+        wrk.avg_eff = get_i32(r+36);
+        wrk.min_eff = get_i32(r+40);
+        wrk.cal = get_i32(r+44);
+        wrk.lengths = get_i32(r+48);
+        wrk.totaldistance = get_i32(r+52);
+        wrk.sync = get_u32(r+56);
+        const quint32 count = get_u32(r+60);
+
+        if ((qint64)set + count > nsets)
+            return false;
+
+        wrk.sets.resize(count);
+        for (quint32 s = 0; s < count; ++s, ++set)
+        {
+            const uchar *sr = stable + (qint64)set * ssize;
+            Set &st = wrk.sets[s];
+
+            st.set = get_i32(sr);
+            st.duration = get_i32(sr+4);
+            st.lens = get_i32(sr+8);
+            st.strk = get_i32(sr+12);
+            st.dist = get_i32(sr+16);
+            st.speed = get_i32(sr+20);
+            st.effic = get_i32(sr+24);
+            st.rate = get_i32(sr+28);
+            st.rest = get_i32(sr+32);
+            st.num = get_f64(sr+36);
+            const quint32 tcount = get_u32(sr+44);
+            const quint32 scount = get_u32(sr+48);
+
+            if ((qint64)time + tcount > ntimes || (qint64)style + scount > nstyles)
+                return false;
+
+            st.first = time - base;
+            st.count = tcount;
+            if (!source)
+                decodeLengths(columns, time, tcount, style, scount, style_codes, *block);
+            time += tcount;
+            style += scount;
+        }
+
+        if (source)
+        {
+            const StoreLengths::Span span = { first_set, count, base, first_style };
+            source->spans.push_back(span);
+            wrk.table = LengthTable(source, n, time - base);
+        }
+        else
+        {
+            wrk.table = LengthTable(block.data(), base, time - base);
+        }
+
+        dst.push_back(wrk);
+    }
+    return true;
+}
+// Store content, each table is built separately then written in order
+struct Tables
+{
+    QByteArray header;
+    QByteArray wtable;
+    QByteArray stable;
+    QByteArray times;
+    QByteArray strokes;
+    QByteArray styles;
+};
+
+void encode(const Workout *begin, const Workout *end, quint64 sequence, Tables &t)
+{
+    StringTable strings;
+    QByteArray &wtable = t.wtable;
+    QByteArray &stable = t.stable;
+    QByteArray &times = t.times;
+    QByteArray &strokes = t.strokes;
+    QByteArray &styles = t.styles;
+
+    quint32 nsets = 0;
+    quint32 ntimes = 0;
+    quint32 nstyles = 0;
+    qint32 lastid = 0;
+
+    wtable.reserve((end - begin) * workout_size);
+
+    const Workout *i;
+    for (i = begin; i != end; ++i)
+    {
+        const int start = wtable.size();
+        lastid = qMax(lastid, i->id);
+        put_i32(wtable, i->id);
+        put_i32(wtable, i->user);
+        put_i32(wtable, start_day(i->start));
+        put_i32(wtable, start_ms(i->start));
+        put_u16(wtable, strings.index(workoutTypes().name(i->type)));
+        put_u16(wtable, strings.index(poolUnits().name(i->unit)));
+        put_i32(wtable, i->pool);
+        put_i32(wtable, i->totalduration);
+        put_i32(wtable, i->rest);
+        put_i32(wtable, i->max_eff);
+        put_i32(wtable, i->avg_eff);
+        put_i32(wtable, i->min_eff);
+        put_i32(wtable, i->cal);
+        put_i32(wtable, i->lengths);
+        put_i32(wtable, i->totaldistance);
+        put_u32(wtable, i->sync);
+        put_u32(wtable, i->sets.size());
+        pad_to(wtable, start, workout_size);
+
+        const LengthTable lengths = i->table.decoded();
+
+        std::vector<Set>::const_iterator j;
+        for (j = i->sets.begin(); j != i->sets.end(); ++j, ++nsets)
+        {
+            const int sstart = stable.size();
+            const quint32 tcount = j->count;
+            quint32 scount = 0;
+            for (quint32 l = 0; l < tcount && !scount; ++l)
+                scount = lengths.style(j->first + l) ? tcount : 0;
+
+            put_i32(stable, j->set);
+            put_i32(stable, j->duration);
+            put_i32(stable, j->lens);
+            put_i32(stable, j->strk);
+            put_i32(stable, j->dist);
+            put_i32(stable, j->speed);
+            put_i32(stable, j->effic);
+            put_i32(stable, j->rate);
+            put_i32(stable, j->rest);
+            put_f64(stable, j->num);
+            put_u32(stable, tcount);
+            put_u32(stable, scount);
+            pad_to(stable, sstart, set_size);
+
+            for (quint32 l = 0; l < tcount; ++l, ++ntimes)
+            {
+                put_f64(times, lengths.time(j->first + l) / 1000.0);
+                put_i32(strokes, lengths.strokes(j->first + l));
+            }
+
+            for (quint32 l = 0; l < scount; ++l, ++nstyles)
+            {
+                put_u16(styles, strings.index(strokeStyles().name(lengths.style(j->first + l))));
+            }
+        }
+    }
+
+    QByteArray &content = t.header;
+    content.append(store_magic, 4);
+    put_u32(content, store_version);
+    put_u32(content, header_size);
+    put_u32(content, workout_size);
+    put_u32(content, set_size);
+    put_u32(content, strings.strings.size());
+    put_u32(content, end - begin);
+    put_u32(content, nsets);
+    put_u32(content, ntimes);
+    put_u32(content, nstyles);
+    put_u64(content, sequence);
+    put_i32(content, lastid);
+
+    std::vector<QString>::const_iterator s;
+    for (s = strings.strings.begin(); s != strings.strings.end(); ++s)
+    {
+        QByteArray utf = s->toUtf8();
+        put_u16(content, utf.size());
+        content.append(utf);
+    }
+
+}
+} //namespace
+
+bool ReadStore( const QString & name, std::vector<Workout>& dst, quint64 *sequence, bool lazy )
+{
+    if (lazy)
+    {
+        // the file stays mapped for decoding lengths later, freed with
+        // the last workout read from it
+        QExplicitlySharedDataPointer<StoreLengths> source(new StoreLengths(name));
+        if (!source->data)
+            return false;
+        return decode(source->data, source->size, dst, sequence, source.data());
+    }
+
+    QFile file(name);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = file.size();
+    const uchar *data = file.map(0, size);
+
+    bool ok;
+    if (data)
+    {
+        ok = decode(data, size, dst, sequence);
+        file.unmap((uchar*)data);
+    }
+    else
+    {
+        // mapping not supported, fall back to a single read
+        QByteArray blob = file.readAll();
+        ok = decode((const uchar*)blob.constData(), blob.size(), dst, sequence);
+    }
+    return ok;
+}
+
+bool ReadStoreHeader( const QString & name, quint64 *sequence, int *lastId )
+{
+    QFile file(name);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    const QByteArray blob = file.read(header_size);
+    const uchar *h = (const uchar*)blob.constData();
+    if (blob.size() < (int)header_size || memcmp(h, store_magic, 4) != 0 ||
+        get_u32(h+4) > store_version || get_u32(h+8) < header_size)
+        return false;
+
+    if (sequence)
+        *sequence = get_u64(h+40);
+    if (lastId)
+        *lastId = get_i32(h+48);
+    return true;
+}
+
+bool SaveStore( const QString & name, const std::vector<Workout>& src, quint64 sequence )
+{
+    return SaveStore(name, src.data(), src.data() + src.size(), sequence);
+}
+
+bool SaveStore( const QString & name, const Workout *begin, const Workout *end, quint64 sequence )
+{
+    Tables t;
+    encode(begin, end, sequence, t);
+
+    // Written alongside, synced and renamed over the old file by commit
+    QSaveFile file(name);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    bool ok = file.write(t.header) == t.header.size() &&
+            file.write(t.wtable) == t.wtable.size() &&
+            file.write(t.stable) == t.stable.size() &&
+            file.write(t.times) == t.times.size() &&
+            file.write(t.strokes) == t.strokes.size() &&
+            file.write(t.styles) == t.styles.size();
+    return ok && file.commit();
+}
+
+void EncodeWorkouts( const Workout *begin, const Workout *end, QByteArray& out )
+{
+    Tables t;
+    encode(begin, end, 0, t);
+
+    out.append(t.header);
+    out.append(t.wtable);
+    out.append(t.stable);
+    out.append(t.times);
+    out.append(t.strokes);
+    out.append(t.styles);
+}
+
+bool DecodeWorkouts( const uchar *data, qint64 size, std::vector<Workout>& dst )
+{
+    return decode(data, size, dst, 0);
+}
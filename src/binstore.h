@@ -0,0 +1,58 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BINSTORE_H
+#define BINSTORE_H
+
+#include <vector>
+#include <QString>
+#include <QByteArray>
+
+struct Workout;
+
+/*
+ * Native binary data file.
+ *
+ * Layout (all values little endian):
+ *   header
+ *   string table     (type, unit and style names)
+ *   workout table    (fixed width records)
+ *   set table        (fixed width records)
+ *   length columns   (times, strokes, styles packed per column)
+ *
+ * Record sizes are stored in the header so fields can be appended to
+ * the tables without breaking older files.
+ */
+
+// Read native data file, appending workouts to dst.
+// sequence is set to the last journal entry included in the file.
+// lazy keeps the file mapped and decodes per length data when first used.
+bool ReadStore( const QString & name, std::vector<Workout>& dst, quint64 *sequence = 0, bool lazy = false );
+
+// Sequence and highest workout id from the header alone
+bool ReadStoreHeader( const QString & name, quint64 *sequence, int *lastId );
+
+// Write all workouts to native data file.
+bool SaveStore( const QString & name, const std::vector<Workout>& src, quint64 sequence = 0 );
+bool SaveStore( const QString & name, const Workout *begin, const Workout *end, quint64 sequence = 0 );
+
+// Same layout held in memory, used for journal entries
+void EncodeWorkouts( const Workout *begin, const Workout *end, QByteArray& out );
+bool DecodeWorkouts( const uchar *data, qint64 size, std::vector<Workout>& dst );
+
+#endif
@@ -146,32 +146,49 @@ void CalendarWidget::setData(const std::map<QDate, Totals> _lens)
     //    n.setHorizontalAlignment(QTextCharFormat::AlignLeft);
     setDateTextFormat(QDate(), n);
 
+    for (i=total.begin(); i!=total.end(); i++)
+        setDateTextFormat(i->first, dayFormat(i->second));
+}
+
+void CalendarWidget::setDay(const QDate &date, const Totals *totals)
+{
+    if (totals)
+    {
+        total[date] = *totals;
+        setDateTextFormat(date, dayFormat(*totals));
+    }
+    else
+    {
+        total.erase(date);
+        QTextCharFormat n;
+        n.setVerticalAlignment(QTextCharFormat::AlignSuperScript);
+        setDateTextFormat(date, n);
+    }
+    updateCell(date);
+}
+
+// Bold with the day's efficiency in its tooltip
+QTextCharFormat CalendarWidget::dayFormat(const Totals &t) const
+{
     QTextCharFormat c;
     c.setFontWeight(QFont::Bold);
     c.setUnderlineStyle(QTextCharFormat::SingleUnderline);
     c.setVerticalAlignment(QTextCharFormat::AlignBottom);
     //    c.setHorizontalAlignment(QTextCharFormat::AlignLeft);
 
-    for (i=total.begin(); i!=total.end(); i++)
-    {
-        Totals &t = i->second;
-        
-        QString tip = 
-            QString("<table><tr><td><b>Distance</b></td><td>%1m</td></tr>"
-                    "<tr><td><b>Worst Efficiency</b></td><td>%2 (%3)</td></tr>"
-                    "<tr><td><b>Average Efficiency</b></td><td>%4 (%5)</td></tr>"
-                    "<tr><td><b>Best Efficiency</b></td><td>%6 (%7)</td></tr></table>")
-            .arg(t.dist)
-            .arg(t.max_eff)
-            .arg(eff[effToId(t.max_eff)])
-            .arg(t.avg_eff)
-            .arg(eff[effToId(t.avg_eff)])
-            .arg(t.min_eff)
-            .arg(eff[effToId(t.min_eff)]);
-        
-        c.setToolTip( tip );
-        setDateTextFormat(i->first,c);
-    }
+    QString tip =
+        QString("<table><tr><td><b>Distance</b></td><td>%1m</td></tr>"
+                "<tr><td><b>Worst Efficiency</b></td><td>%2 (%3)</td></tr>"
+                "<tr><td><b>Average Efficiency</b></td><td>%4 (%5)</td></tr>"
+                "<tr><td><b>Best Efficiency</b></td><td>%6 (%7)</td></tr></table>")
+        .arg(t.dist)
+        .arg(t.max_eff)
+        .arg(eff[effToId(t.max_eff)])
+        .arg(t.avg_eff)
+        .arg(eff[effToId(t.avg_eff)])
+        .arg(t.min_eff)
+        .arg(eff[effToId(t.min_eff)]);
+
+    c.setToolTip( tip );
+    return c;
 }
-
-
@@ -22,6 +22,7 @@
 #include <map>
 
 #include <QCalendarWidget>
+#include <QTextCharFormat>
 
 class CalendarWidget : public QCalendarWidget
 {
@@ -38,11 +39,15 @@ public:
     CalendarWidget(QWidget *parent = 0);
 
     void setData(const std::map<QDate, Totals>);
+    // Change one day, totals 0 clears it
+    void setDay(const QDate &date, const Totals *totals);
 
 protected:
     virtual void	paintCell ( QPainter * painter, const QRect & rect, const QDate & date ) const;
 
 private:
+    QTextCharFormat dayFormat(const Totals &t) const;
+
     std::map<QDate, Totals> total;
 };
 
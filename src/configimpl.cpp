@@ -16,9 +16,13 @@
  * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QMessageBox>
 #include <QSettings>
 
 #include "authdialog.h"
+#include "backup.h"
 #include "configimpl.h"
 
 ConfigImpl::ConfigImpl( QWidget * parent, Qt::WindowFlags f)
@@ -62,6 +66,13 @@ ConfigImpl::ConfigImpl( QWidget * parent, Qt::WindowFlags f)
 
     dataFile->setText(path);
     backup->setChecked(settings.value("backup").toBool());
+    backupKeep->setValue(settings.value("backupKeep", 20).toInt());
+    csvExport->setChecked(settings.value("csvExport").toBool());
+    loadThreads->setValue(settings.value("loadThreads").toInt());
+    lazyLoad->setChecked(settings.value("lazyLoad").toBool());
+    database->setChecked(settings.value("database").toBool());
+    autosaveMinutes->setValue(settings.value("autosaveMinutes", 5).toInt());
+    autosaveEdits->setValue(settings.value("autosaveEdits", 50).toInt());
 
     garminUser->setText(settings.value("garminUser").toString());
     garminPassword->setText(settings.value("garminPass").toString());
@@ -100,6 +111,13 @@ void ConfigImpl::on_buttonBox_accepted()
     }
 
     settings.setValue("backup", backup->isChecked());
+    settings.setValue("backupKeep", backupKeep->value());
+    settings.setValue("csvExport", csvExport->isChecked());
+    settings.setValue("loadThreads", loadThreads->value());
+    settings.setValue("lazyLoad", lazyLoad->isChecked());
+    settings.setValue("database", database->isChecked());
+    settings.setValue("autosaveMinutes", autosaveMinutes->value());
+    settings.setValue("autosaveEdits", autosaveEdits->value());
 
     settings.setValue("garminUser", garminUser->text());
     settings.setValue("garminPass", garminPassword->text());
@@ -145,3 +163,27 @@ void ConfigImpl::on_stravaAuth_clicked()
     if (!stravaToken.isEmpty())
         stravaAuth->setIcon(QIcon(":/images/tick.png"));
 }
+
+void ConfigImpl::on_restoreBackup_clicked()
+{
+    // Each year's backups are in a directory next to its data file
+    const QString backup = QFileDialog::getOpenFileName(this, tr("Restore Backup"),
+                                                        QFileInfo(dataFile->text()).path(),
+                                                        tr("Backups (backup-*)"));
+    if (backup.isEmpty())
+        return;
+
+    // To a new file, the one in use is written again on exit
+    const QFileInfo info(backup);
+    const QString file = QFileDialog::getSaveFileName(this, tr("Save Restored File"),
+                                                      QFileInfo(info.path()).path() + "/" + info.fileName() + ".pvd",
+                                                      tr("Data files (*.pvd)"));
+    if (file.isEmpty())
+        return;
+
+    if (RestoreBackup(info.path(), info.fileName(), file))
+        QMessageBox::information(this, tr("Restore Backup"),
+                                 tr("Restored to %1, copy it over the data file while PoolMate Viewer is closed.").arg(file));
+    else
+        QMessageBox::warning(this, tr("Restore Backup"), tr("The backup could not be restored."));
+}
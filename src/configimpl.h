@@ -44,6 +44,8 @@ private slots:
 
     void on_stravaAuth_clicked();
 
+    void on_restoreBackup_clicked();
+
 private:
 };
 
@@ -17,537 +17,2407 @@
  */
 
 #include <QStringList>
-#include <QTextStream>
 #include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
 #include <QDateTime>
+#include <QSharedPointer>
+#include <QSet>
+#include <QtConcurrent>
+#include <QThread>
+#include <QThreadPool>
 
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 
 #include <algorithm>
+#include <limits>
 #include "datastore.h"
 
 #include "exerciseset.h"
+#include "backup.h"
+#include "binstore.h"
+#include "journal.h"
+#include "sqlstore.h"
 
-//TODO use database file and change CSV logic for just import/export
+// Data is kept in a native binary file, CSV is just used for import/export.
+// Changes go to an append only journal which is folded into the data file
+// in the background once it grows.
+
+namespace {
+const char csv_header[] = "User Number,Date,Time,Type,Pool Length,,Duration,Calories,Total Laps,Total Distance,Set Number,Set Duration,Average Strokes,Distance,Speed,Efficiency,Stroke Rate,,,,,,Watch Version,Status,Notes\n";
+
+// Builds csv text by hand into one buffer written out in large blocks.
+// Formats every field the same way QTextStream and QTime::toString did,
+// which were most of the cost of a save.
+class CsvWriter
+{
+public:
+    explicit CsvWriter( QIODevice &_out ) : out(_out), ok(true) { buf.reserve(block + 4096); }
+
+    CsvWriter &operator<<( char c ) { buf += c; return *this; }
+    CsvWriter &operator<<( const char *s ) { buf += s; return *this; }
+    CsvWriter &operator<<( const QString &s ) { buf += s.toLocal8Bit(); return *this; }
+    CsvWriter &operator<<( int v );
+
+    // hh:mm:ss, or mm:ss of the hour, empty if not a time of day
+    void time( int msecs, bool hours = true );
+    // d/M/yyyy and hh:mm:ss of a start, empty if there is none
+    void date( qint64 start );
+    void clock( qint64 start );
+    // as QTextStream prints a double, 6 significant digits
+    void real( double v );
+    // as QString::number(v, 'f', 3)
+    void fixed3( double v );
+
+    // End of a row, the buffer goes out once it is big enough
+    void endRow()
+    {
+        buf += '\n';
+        if (buf.size() >= block)
+            flush();
+    }
+    bool flush()
+    {
+        if (ok && !buf.isEmpty())
+            ok = out.write(buf) == buf.size();
+        buf.resize(0); // keeps the reserved space, clear() would free it
+        return ok;
+    }
+
+private:
+    static const int block = 256*1024;
+
+    void two( int v )
+    {
+        buf += char('0' + v / 10);
+        buf += char('0' + v % 10);
+    }
+    void digits( quint64 v );
+
+    QIODevice &out;
+    QByteArray buf;
+    bool ok;
+};
+
+void CsvWriter::digits( quint64 v )
+{
+    char tmp[20];
+    int n = 0;
+    do
+    {
+        tmp[n++] = char('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n)
+        buf += tmp[--n];
+}
+
+CsvWriter &CsvWriter::operator<<( int v )
+{
+    if (v < 0)
+        buf += '-';
+    digits(v < 0 ? -(qint64)v : v);
+    return *this;
+}
+
+void CsvWriter::time( int msecs, bool hours )
+{
+    if (msecs < 0 || msecs >= 86400000)
+        return;
+    const int secs = msecs / 1000;
+    if (hours)
+    {
+        two(secs / 3600);
+        buf += ':';
+    }
+    two(secs / 60 % 60);
+    buf += ':';
+    two(secs % 60);
+}
+
+void CsvWriter::date( qint64 start )
+{
+    if (start == NO_START)
+        return;
+    const QDate d = startDate(start);
+    if (d.year() < 1000 || d.year() > 9999)
+    {
+        buf += d.toString("d/M/yyyy").toLatin1();
+        return;
+    }
+    digits(d.day());
+    buf += '/';
+    digits(d.month());
+    buf += '/';
+    digits(d.year());
+}
+
+void CsvWriter::clock( qint64 start )
+{
+    if (start == NO_START)
+        return;
+    time(int(start - startDay(start) * 86400) * 1000);
+}
+
+void CsvWriter::real( double v )
+{
+    // whole milliseconds under 1000s print exactly at 6 significant digits
+    const qint64 ms = v >= 0 && v < 1000 && !signbit(v) ? qRound64(v * 1000) : -1;
+    if (ms < 0 || ms / 1000.0 != v)
+    {
+        buf += QByteArray::number(v, 'g', 6);
+        return;
+    }
+    digits(ms / 1000);
+    int frac = ms % 1000;
+    if (!frac)
+        return;
+    buf += '.';
+    buf += char('0' + frac / 100);
+    frac = frac % 100;
+    if (frac)
+    {
+        buf += char('0' + frac / 10);
+        if (frac % 10)
+            buf += char('0' + frac % 10);
+    }
+}
+
+void CsvWriter::fixed3( double v )
+{
+    const qint64 ms = v >= 0 && v < 1e12 && !signbit(v) ? qRound64(v * 1000) : -1;
+    if (ms < 0 || ms / 1000.0 != v)
+    {
+        buf += QByteArray::number(v, 'f', 3);
+        return;
+    }
+    digits(ms / 1000);
+    buf += '.';
+    const int frac = ms % 1000;
+    buf += char('0' + frac / 100);
+    two(frac % 100);
+}
+
+void writeRow( CsvWriter &out, const ExerciseSet &row )
+{
+    out << row.user << ',';
+    out.date(row.start);
+    out << ',';
+    out.clock(row.start);
+    out << ',';
+
+    const bool hr = row.type == QLatin1String("SwimHR");
+    if (hr || row.type == QLatin1String("Swim"))
+    {
+        out << row.type << ','
+            << row.pool << ',';
+        //                    << row.unit << ","
+        // This field is now unused so we'll use this one to insert custom lap styles
+        uint l;
+        for (l=0; l < row.len_style.size(); l++) {
+            out << row.len_style[l] << ';';
+        }
+        out << ',';
+
+        out.time(row.totalduration);
+        out << ','
+            << row.cal << ','
+            << row.lengths << ','
+            << row.totaldistance << ','
+            << row.set << ',';
+        out.time(row.duration);
+        out << ','
+            << row.strk << ','
+            << row.lens << ','
+            << row.speed << ','
+            << row.effic << ','
+            << row.rate << ','
+            << "Free" << ',';
+
+        //1,31/3/2015,06:38:12,SwimHR,25,,00:32:38,397,52,1300,1,00:06:19,12,12,126,44,22,Free,
+        //,,,,0,New,00:32:38,,STARTOFLAPDATA,0,0,0,3908.923,00:14,SwimHR,11,-1,
+        //28,12,31,13,31.125,13,31.625,13,31.25,13,31.125,13,29.5,11,33.375,13,30.375,13,31.75,12,33.125,13,33,13
+        if (hr)
+        {
+            out << ",,,,0,New,"; //Can mark edited values
+            out.time(row.totalduration);
+            out << ',';
+
+            //Only interested in syncing SwimHR data so insert sync status flags here
+            if (row.sync & SYNC_GARMIN)
+                out << 'G';
+            if (row.sync & SYNC_STRAVA)
+                out << 'S';
+            if (row.sync & SYNC_FIT)
+                out << 'F';
+
+            out << ",STARTOFLAPDATA,0,0,0,";
+            //<< row.num << ","
+            out.fixed3(row.num);
+            out << ',';
+            out.time(row.rest, false);
+            out << ','
+                << row.type << ','
+                << row.lens-1 << ','
+                << "-1";
+
+            int l;
+            for (l=0; l<row.lens; ++l)
+            {
+                out << ',';
+                out.real(row.len_time[l]);
+                out << ',' << row.len_strokes[l];
+            }
+        }
+        else
+        {
+            out << ",,,,210,,,";
+        }
+    }
+    else
+    {
+        out << row.type << ','
+            << ",,";
+        out.time(row.totalduration);
+        out << ','
+            << ",,,"
+            << row.set << ',';
+        out.time(row.duration);
+        out << ','
+            << ",,,,,,"
+            << ",,,,210,,,";
+    }
+    out.endRow();
+}
+} //namespace
 
 // Stick to same file format as poolmate app for now so we can share files
 bool SaveCSV( const std::string & name, std::vector<ExerciseSet>& exercises )
 {
-    QFile file(name.c_str());
-    if (file.open(QIODevice::WriteOnly|QIODevice::Text))
+    // old file is only replaced once the new one is on disk
+    QSaveFile file(name.c_str());
+    if (!file.open(QIODevice::WriteOnly|QIODevice::Text))
+        return false;
+
+    CsvWriter out(file);
+
+    //New format
+    out << csv_header;
+
+    std::vector<ExerciseSet>::const_iterator i;
+    for (i=exercises.begin(); i != exercises.end(); ++i)
+        writeRow(out, *i);
+
+    return out.flush() && file.commit();
+}
+
+namespace {
+// Span of one csv field, points straight into the file buffer
+struct Field
+{
+    const char *b;
+    const char *e;
+
+    int size() const { return e - b; }
+    bool operator==(const char *s) const
+    {
+        return size() == (int)strlen(s) && memcmp(b, s, size()) == 0;
+    }
+    bool contains(char c) const { return memchr(b, c, size()) != 0; }
+};
+
+bool isSpace(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Same rules as QString::toInt, surrounding whitespace allowed
+bool toInt(const char *b, const char *e, int &value)
+{
+    while (b < e && isSpace(*b)) ++b;
+    while (e > b && isSpace(e[-1])) --e;
+
+    bool neg = false;
+    if (b < e && (*b == '-' || *b == '+'))
+        neg = (*b++ == '-');
+    if (b == e)
+        return false;
+
+    qint64 v = 0;
+    for (; b < e; ++b)
+    {
+        if (*b < '0' || *b > '9')
+            return false;
+        v = v*10 + (*b - '0');
+        if (v > 2147483648LL)
+            return false;
+    }
+    if (neg)
+        v = -v;
+    if (v > 2147483647LL)
+        return false;
+    value = (int)v;
+    return true;
+}
+
+int toInt(const Field &f)
+{
+    int v = 0;
+    return toInt(f.b, f.e, v) ? v : 0;
+}
+
+// Plain decimals are exact when the digits and the power of ten both fit a
+// double, anything else goes through Qt.
+double toDouble(const Field &f)
+{
+    static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                                    1e11, 1e12, 1e13, 1e14, 1e15 };
+    const char *b = f.b;
+    const char *e = f.e;
+    while (b < e && isSpace(*b)) ++b;
+    while (e > b && isSpace(e[-1])) --e;
+
+    const char *p = b;
+    bool neg = false;
+    if (p < e && (*p == '-' || *p == '+'))
+        neg = (*p++ == '-');
+
+    qint64 mantissa = 0;
+    int digits = 0;
+    int decimals = -1;
+    for (; p < e; ++p)
+    {
+        if (*p == '.' && decimals < 0)
+            decimals = 0;
+        else if (*p >= '0' && *p <= '9')
+        {
+            mantissa = mantissa*10 + (*p - '0');
+            if (decimals >= 0)
+                decimals++;
+            if (++digits > 15)
+                break;
+        }
+        else
+            break;
+    }
+
+    if (p == e && digits)
+    {
+        double v = decimals > 0 ? mantissa / pow10[decimals] : (double)mantissa;
+        return neg ? -v : v;
+    }
+    if (b == e)
+        return 0;
+    return QByteArray(b, e - b).toDouble();
+}
+
+// Read between min and max digits
+bool digits(const char *&p, const char *e, int min, int max, int &value)
+{
+    int n = 0;
+    value = 0;
+    while (p < e && n < max && *p >= '0' && *p <= '9')
+    {
+        value = value*10 + (*p++ - '0');
+        n++;
+    }
+    return n >= min;
+}
+
+// d/M/yyyy
+QDate toDate(const Field &f)
+{
+    const char *p = f.b;
+    int d, m, y;
+    if (!digits(p, f.e, 1, 2, d) || p == f.e || *p++ != '/' ||
+        !digits(p, f.e, 1, 2, m) || p == f.e || *p++ != '/' ||
+        !digits(p, f.e, 4, 4, y) || p != f.e)
+        return QDate();
+    return QDate(y, m, d);
+}
+
+// Matches QTime::fromString(s) i.e. hh:mm[:ss[.zzz]]
+QTime toTime(const Field &f)
+{
+    const char *s = f.b;
+    const int size = f.size();
+    if (size < 5 || s[2] != ':')
+        return QTime();
+
+    int hour, minute, second = 0, msec = 0;
+    if (!toInt(s, s + 2, hour) || !toInt(s + 3, s + 5, minute))
+        return QTime();
+
+    if (size > 5)
+    {
+        if (s[5] == ',' || s[5] == '.')
+            return QTime();
+        if (!toInt(s + 6, s + qMin(size, 8), second))
+            return QTime();
+        if (size > 8 && (s[8] == ',' || s[8] == '.'))
+        {
+            const int n = qMin(size - 9, 4);
+            int fraction = 0;
+            if (n && !toInt(s + 9, s + 9 + n, fraction))
+                return QTime();
+            msec = qMin(qRound(fraction / pow(10.0, n) * 1000.0), 999);
+        }
+    }
+    return QTime(hour, minute, second, msec);
+}
+
+// mm:ss
+QTime toRest(const Field &f)
+{
+    const char *p = f.b;
+    int m, s;
+    if (!digits(p, f.e, 1, 2, m) || p == f.e || *p++ != ':' ||
+        !digits(p, f.e, 1, 2, s) || p != f.e)
+        return QTime();
+    return QTime(0, m, s);
+}
+
+// Split [b,e) at sep into reused field list
+void split(const char *b, const char *e, char sep, std::vector<Field> &out)
+{
+    out.clear();
+    for (;;)
+    {
+        const char *n = (const char*)memchr(b, sep, e - b);
+        Field f = { b, n ? n : e };
+        out.push_back(f);
+        if (!n)
+            break;
+        b = n + 1;
+    }
+}
+
+// Type and style names repeat on every row, hand out shared copies
+class Names
+{
+public:
+    QString get(const Field &f)
+    {
+        std::vector<std::pair<QByteArray, QString> >::const_iterator i;
+        for (i=names.begin(); i != names.end(); ++i)
+        {
+            if (i->first.size() == f.size() && memcmp(i->first.constData(), f.b, f.size()) == 0)
+                return i->second;
+        }
+        QByteArray key(f.b, f.size());
+        names.push_back(std::make_pair(key, QString::fromUtf8(key)));
+        return names.back().second;
+    }
+
+private:
+    std::vector<std::pair<QByteArray, QString> > names;
+};
+
+// Parses poolmate csv rows in place
+class CsvParser
+{
+public:
+    CsvParser(bool _oldformat) : oldformat(_oldformat) {}
+
+    // Rows are handed to dst.push_back() as they are parsed
+    template<class Rows>
+    void parse(const char *b, const char *e, Rows& dst)
+    {
+        while (b < e)
+        {
+            const char *n = line(b, e);
+
+            ExerciseSet row;
+            if (parseRow(row))
+                dst.push_back(row);
+
+            b = n ? n + 1 : e;
+        }
+    }
+
+    // Start time of the row at b
+    qint64 rowStart(const char *b, const char *e);
+
+private:
+    // Split the line at b into fields, returns its newline if any
+    const char *line(const char *b, const char *e);
+    // false for rows to skip
+    bool parseRow(ExerciseSet& e);
+
+    Field value(int i) const
+    {
+        if (i < (int)strings.size())
+            return strings[i];
+        Field f = { 0, 0 };
+        return f;
+    }
+
+    bool oldformat;
+    std::vector<Field> strings;
+    std::vector<Field> styles;
+    Names names;
+};
+
+const char *CsvParser::line(const char *b, const char *e)
+{
+    const char *n = (const char*)memchr(b, '\n', e - b);
+    const char *end = n ? n : e;
+    if (end > b && end[-1] == '\r')
+        --end;
+
+    split(b, end, ',', strings);
+    return n;
+}
+
+qint64 CsvParser::rowStart(const char *b, const char *e)
+{
+    line(b, e);
+    return toStart(toDate(value(1)), toTime(value(2)));
+}
+
+bool CsvParser::parseRow(ExerciseSet& e)
+{
+    e.sync=0;
+    e.user = toInt(value(0));
+    e.start = toStart(toDate(value(1)), toTime(value(2)));
+
+    e.type = names.get(value(3));
+    e.totalduration = toMsecs(toTime(value(6)));
+    e.set = toInt(value(10));
+    e.duration = toMsecs(toTime(value(11)));
+
+    if (e.type == "Swim" || e.type == "SwimHR")
+    {
+        e.pool = toInt(value(4));
+        // e.unit = value(5); //no longer used
+        e.cal = toInt(value(7));
+        e.lengths = toInt(value(8));
+        e.totaldistance = toInt(value(9));
+        e.strk = toInt(value(12));
+        e.lens  = toInt(value(13));
+
+        if (oldformat && e.lens && e.pool) //if we've saved as an oldformat file update to new
+        {
+            e.lens = toInt(value(13)) / e.pool;
+        }
+        e.dist = e.lens * e.pool;
+        e.speed  = toInt(value(14));
+        e.effic = toInt(value(15));
+        e.rate  = toInt(value(16));
+
+        if (e.lens == 0) //Duplicate swimovate data
+        {
+            e.speed = 0;
+            e.rate = 0;
+            e.effic = e.strk;
+        }
+    }
+
+    //1,31/3/2015,06:38:12,SwimHR,25,,00:32:38,397,52,1300,1,00:06:19,12,12,126,44,22,Free,,,,,0,
+    //New,00:32:38,,STARTOFLAPDATA,
+    //0,0,0,3908.923,00:14,SwimHR,
+    //11,-1,28,12,31,13,31.125,13,31.625,13,31.25,13,31.125,13,29.5,11,33.375,13,30.375,13,31.75,12,33.125,13,33,13
+    //Ignore HR part of data for now.
+
+    if (e.type == "HRChrono")
+    {
+        if (value(23) == "Deleted")
+        {
+            return false; //just drop deleted rows.
+        }
+    }
+
+    if (e.type == "SwimHR") // Read length data
+    {
+        if (value(23) == "Deleted")
+        {
+            return false; //just drop deleted rows.
+        }
+
+        const Field status = value(25);
+        e.sync=0;
+        if (status.contains('F'))
+            e.sync |= SYNC_FIT;
+        if (status.contains('G'))
+            e.sync |= SYNC_GARMIN;
+        if (status.contains('S'))
+            e.sync |= SYNC_STRAVA;
+
+        double num = toDouble(value(30)); //no idea what this is
+        e.num = num;
+        e.rest = toMsecs(toRest(value(31)));
+
+        const Field stylelist = value(5);
+        split(stylelist.b, stylelist.e, ';', styles);
+        bool hasstyles=false;
+        if (styles.size()>1)
+        {
+            hasstyles=true;
+        }
+
+        //Are we loading a file with the styles appended at the end?
+        bool oldstyles = ((int)strings.size() > 35+e.lens*2);
+        if (e.lens > 0)
+        {
+            e.len_time.reserve(e.lens);
+            e.len_strokes.reserve(e.lens);
+        }
+        int l;
+        for (l = 0; l <e.lens; ++l)
+        {
+            double time = toDouble(value(35+l*2));
+            int strk = toInt(value(36+l*2));
+
+            QString style;
+            if (oldstyles)
+            {
+                style = names.get(value(35+e.lens*2+l));
+            }
+            else if (hasstyles && l < (int)styles.size())
+            {
+                style = names.get(styles[l]);
+            }
+
+            e.len_time.push_back(time);
+            e.len_strokes.push_back(strk);
+            if (hasstyles || oldstyles)
+                e.len_style.push_back(style);
+        }
+
+        //Check we have nothing but empty styles
+        uint j;
+        bool empty=true;
+        for (j=0; j < e.len_style.size(); j++) {
+            if (e.len_style[j].length())
+                empty=false;
+        }
+        if (empty)
+            e.len_style.clear();
+    }
+    return true;
+}
+} //namespace
+
+void LengthBlock::reserve( size_t n )
+{
+    times.reserve(n);
+    strokes.reserve(n);
+    styles.reserve(n);
+}
+
+void LengthBlock::append( qint32 msecs, quint16 _strokes, quint16 style )
+{
+    times.push_back(msecs);
+    strokes.push_back(_strokes);
+    styles.push_back(style);
+}
+
+LengthTable LengthTable::decoded() const
+{
+    if (block || !source)
+        return *this;
+    return LengthTable(source->lengths(first).data(), 0, count);
+}
+
+// Take a private copy unless this table is the only user of the whole block
+void LengthTable::detach()
+{
+    if (block && block->ref.load() == 1 && first == 0 && count == (int)block->times.size())
+        return;
+
+    const LengthTable src = decoded();
+    LengthBlock *own = new LengthBlock;
+    own->reserve(count + 1);
+    for (int l = 0; l < count; ++l)
+        own->append(src.time(l), src.strokes(l), src.style(l));
+
+    block = own;
+    source.reset();
+    first = 0;
+}
+
+void LengthTable::insert( int l, qint32 msecs, quint16 _strokes, quint16 _style )
+{
+    detach();
+    block->times.insert(block->times.begin() + l, msecs);
+    block->strokes.insert(block->strokes.begin() + l, _strokes);
+    block->styles.insert(block->styles.begin() + l, _style);
+    ++count;
+}
+
+void LengthTable::remove( int l, int n )
+{
+    detach();
+    block->times.erase(block->times.begin() + l, block->times.begin() + l + n);
+    block->strokes.erase(block->strokes.begin() + l, block->strokes.begin() + l + n);
+    block->styles.erase(block->styles.begin() + l, block->styles.begin() + l + n);
+    count -= n;
+}
+
+void Workout::addLength( int s, int msecs, int strokes, int style )
+{
+    const int pos = sets[s].first + sets[s].count;
+    table.insert(pos, msecs, strokes, style);
+
+    for (size_t i = 0; i < sets.size(); ++i)
+    {
+        if ((int)i != s && sets[i].first >= pos)
+            ++sets[i].first;
+    }
+    ++sets[s].count;
+}
+
+void Workout::removeSet( int s )
+{
+    const Set gone = sets[s];
+    sets.erase(sets.begin() + s);
+    if (!gone.count)
+        return;
+
+    table.remove(gone.first, gone.count);
+    for (size_t i = 0; i < sets.size(); ++i)
+    {
+        if (sets[i].first > gone.first)
+            sets[i].first -= gone.count;
+    }
+}
+
+namespace {
+// Pack a set's lengths onto the end of the block, base is where the workout starts
+void packLengths( const ExerciseSet &src, Set &set, LengthBlock &block, int base )
+{
+    Vocabulary &styles = strokeStyles();
+    set.first = block.times.size() - base;
+    set.count = src.len_time.size();
+
+    for (int l = 0; l < set.count; ++l)
+    {
+        block.append(qRound(src.len_time[l] * 1000),
+                     l < (int)src.len_strokes.size() ? src.len_strokes[l] : 0,
+                     l < (int)src.len_style.size() ? styles.code(src.len_style[l]) : 0);
+    }
+}
+
+void unpackLengths( const Workout &wrk, const Set &set, ExerciseSet &dst )
+{
+    const LengthTable lengths = wrk.table.decoded();
+    bool styled = false;
+    for (int l = 0; l < set.count; ++l)
+        styled = styled || lengths.style(set.first + l);
+
+    dst.len_time.resize(set.count);
+    dst.len_strokes.resize(set.count);
+    dst.len_style.resize(styled ? set.count : 0);
+
+    for (int l = 0; l < set.count; ++l)
+    {
+        dst.len_time[l] = lengths.time(set.first + l) / 1000.0;
+        dst.len_strokes[l] = lengths.strokes(set.first + l);
+        if (styled)
+            dst.len_style[l] = strokeStyles().name(lengths.style(set.first + l));
+    }
+}
+
+// import, csv rows of a workout share its start time and come together
+class WorkoutBuilder
+{
+public:
+    WorkoutBuilder(std::vector<Workout> &_workouts, size_t lengths = 0)
+        : workouts(_workouts), block(new LengthBlock), open(false)
+    {
+        block->reserve(lengths);
+    }
+
+    ~WorkoutBuilder() { finish(); }
+
+    void push_back(const ExerciseSet &row)
+    {
+        if (!open || row.start != workouts.back().start)
+            begin(row);
+
+        Workout &wrk = workouts.back();
+
+        Set set;
+        set.set = ++n;
+        total += qMax(row.duration, 0) / 1000;
+
+        set.duration = row.duration;
+        set.lens = row.lens;
+        set.strk = row.strk;
+        set.dist = row.dist;
+        set.speed = row.speed;
+        set.effic = row.effic;
+        set.rate = row.rate;
+        set.rest = row.rest;
+
+        if (set.rest >= 0) // Only set rest data from live
+        {
+            if (rest < 0)
+                rest = set.rest;
+            else
+                rest = (rest + set.rest / 1000 * 1000) % 86400000;
+        }
+        set.num = row.num;
+
+        packLengths(row, set, *block, base);
+
+        if (set.effic > 0 && set.effic < min_effic) min_effic = set.effic;
+        if (set.effic > max_effic) max_effic = set.effic;
+
+        avg_effic += set.effic;
+
+        wrk.sets.push_back(set);
+    }
+
+    // Complete the last workout
+    void finish()
+    {
+        if (!open)
+            return;
+        open = false;
+
+        Workout &wrk = workouts.back();
+
+        // wraps at a day as QTime did
+        if (rest < 0)
+            rest = ((qMax(wrk.totalduration, 0) / 1000 - total) % 86400 + 86400) % 86400 * 1000;
+
+        wrk.rest = rest;
+        wrk.min_eff = min_effic;
+        wrk.avg_eff = avg_effic / wrk.sets.size();
+        wrk.max_eff = max_effic;
+        wrk.table = LengthTable(block.data(), base, block->times.size() - base);
+    }
+
+private:
+    void begin(const ExerciseSet &row)
+    {
+        finish();
+
+        workouts.push_back(Workout());
+        Workout &wrk = workouts.back();
+        wrk.user = row.user;
+        wrk.start = row.start;
+        wrk.type = workoutTypes().code(row.type);
+        wrk.pool = row.pool;
+        wrk.unit = poolUnits().code(row.unit);
+        wrk.totalduration = row.totalduration;
+        wrk.cal = row.cal;
+        wrk.lengths = row.lengths;
+        wrk.totaldistance = row.totaldistance;
+        wrk.sync = row.sync;
+
+        open = true;
+        n = 0;
+        rest = -1;
+        total = 0;
+        min_effic = 999;
+        avg_effic = 0;
+        max_effic = 0;
+        base = block->times.size();
+    }
+
+    std::vector<Workout> &workouts;
+    QExplicitlySharedDataPointer<LengthBlock> block;
+
+    bool open;
+    int n;
+    int rest;
+    int total;
+    int min_effic;
+    int avg_effic;
+    int max_effic;
+    int base;
+};
+
+void setsToWorkouts( const std::vector<ExerciseSet>& sets,
+                     std::vector<Workout>& workouts)
+{
+    // size everything up front, lengths of all workouts share one block
+    size_t nworkouts = 0;
+    size_t nlengths = 0;
+    std::vector<ExerciseSet>::const_iterator i;
+    for (i=sets.begin(); i != sets.end(); ++i)
+    {
+        if (i == sets.begin() || i->start != (i-1)->start)
+            ++nworkouts;
+        nlengths += i->len_time.size();
+    }
+    workouts.reserve(workouts.size() + nworkouts);
+
+    WorkoutBuilder builder(workouts, nlengths);
+    for (i=sets.begin(); i != sets.end(); ++i)
+        builder.push_back(*i);
+}
+
+// export, one set as a csv row
+void setToRow( const Workout &wrk, const Set &set, int setnum, ExerciseSet &s )
+{
+    s.user = wrk.user;
+    s.start = wrk.start;
+    s.type = workoutTypes().name(wrk.type);
+    s.pool = wrk.pool;
+    s.unit = poolUnits().name(wrk.unit);
+    s.totalduration = wrk.totalduration;
+    s.cal = wrk.cal;
+    s.lengths = wrk.lengths;
+    s.totaldistance = wrk.totaldistance;
+    s.sync = wrk.sync;
+
+    //Recalc setids in case of deletions for compatibility with Poolmate software
+    s.set = setnum; //set.set;
+    s.duration = set.duration;
+    s.lens = set.lens;
+    s.strk = set.strk;
+    s.dist = set.dist;
+    s.speed = set.speed;
+    s.effic = set.effic;
+    s.rate = set.rate;
+    s.rest = set.rest;
+    s.num = set.num;
+
+    unpackLengths(wrk, set, s);
+}
+} //namespace
+
+namespace {
+// Smaller files aren't worth handing out to threads
+const qint64 chunk_min = 256*1024;
+
+// Start of the next line after p
+const char *nextLine(const char *p, const char *e)
+{
+    const char *nl = (const char*)memchr(p, '\n', e - p);
+    return nl ? nl + 1 : e;
+}
+
+// Move a chunk boundary forward past the rows of the workout it splits
+const char *workoutBoundary(const char *p, const char *e, CsvParser &parser)
+{
+    p = nextLine(p, e);
+    if (p == e)
+        return e;
+
+    const qint64 start = parser.rowStart(p, e);
+    const char *next = nextLine(p, e);
+    while (next < e && parser.rowStart(next, e) == start)
+        next = nextLine(next, e);
+    return next;
+}
+
+void parseRows(const char *b, const char *e, bool oldformat, std::vector<ExerciseSet> *dst)
+{
+    CsvParser parser(oldformat);
+    parser.parse(b, e, *dst);
+}
+
+void parseWorkouts(const char *b, const char *e, bool oldformat, std::vector<Workout> *dst)
+{
+    CsvParser parser(oldformat);
+    WorkoutBuilder builder(*dst);
+    parser.parse(b, e, builder);
+}
+
+// Split between workouts, parse each chunk on the pool and join in order
+template<class T>
+void parseParallel(const char *b, const char *e, bool oldformat, int threads, std::vector<T>& dst,
+                   void (*parseChunk)(const char *, const char *, bool, std::vector<T> *))
+{
+    if (threads <= 0)
+        threads = QThread::idealThreadCount();
+    const int chunks = (int)qMin<qint64>(threads, (e - b) / chunk_min);
+
+    if (chunks <= 1)
+    {
+        parseChunk(b, e, oldformat, &dst);
+        return;
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+
+    CsvParser parser(oldformat);
+    std::vector<std::vector<T> > parts(chunks);
+    std::vector<QFuture<void> > running;
+    const qint64 step = (e - b) / chunks;
+    const char *start = b;
+    for (int c = 0; c < chunks && start < e; ++c)
+    {
+        const char *end = e;
+        if (c < chunks - 1 && start + step < e)
+            end = workoutBoundary(start + step, e, parser);
+        running.push_back(QtConcurrent::run(&pool, parseChunk, start, end, oldformat, &parts[c]));
+        start = end;
+    }
+
+    size_t total = dst.size();
+    for (size_t i = 0; i < running.size(); ++i)
+    {
+        running[i].waitForFinished();
+        total += parts[i].size();
+    }
+
+    // swap rather than copy each entry across
+    dst.reserve(total);
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+        for (size_t j = 0; j < parts[i].size(); ++j)
+        {
+            dst.push_back(T());
+            std::swap(dst.back(), parts[i][j]);
+        }
+        std::vector<T>().swap(parts[i]);
+    }
+}
+
+// Map the csv file and hand its rows to parseParallel
+template<class T>
+bool readCSV(const std::string &name, int threads, std::vector<T>& dst,
+             void (*parseChunk)(const char *, const char *, bool, std::vector<T> *))
+{
+    // Simplistic csv format reading, fields are parsed straight out of the
+    // mapped file
+    QFile file(name.c_str());
+    if (file.open(QIODevice::ReadOnly))
+    {
+        qint64 size = file.size();
+        const char *data = (const char*)file.map(0, size);
+        const bool mapped = data != 0;
+
+        QByteArray blob;
+        if (!mapped)
+        {
+            // mapping not supported, fall back to a single read
+            blob = file.readAll();
+            data = blob.constData();
+            size = blob.size();
+        }
+
+        const char *p = data;
+        const char *end = data + size;
+        if (size >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0)
+            p += 3;
+
+        //skip header
+        const char *body = nextLine(p, end);
+        bool oldformat = QByteArray::fromRawData(p, body - p).contains("LogDate");
+
+        parseParallel(body, end, oldformat, threads, dst, parseChunk);
+
+        if (mapped)
+            file.unmap((uchar*)data);
+    }
+    return true;
+}
+} //namespace
+
+bool ReadCSV( const std::string & name, std::vector<ExerciseSet>& dst )
+{
+    return ReadCSV(name, dst, 0);
+}
+
+//
+bool ReadCSV( const std::string & name, std::vector<ExerciseSet>& dst, int threads )
+{
+    return readCSV(name, threads, dst, parseRows);
+}
+
+bool ReadCSV( const std::string & name, std::vector<Workout>& dst, int threads )
+{
+    return readCSV(name, threads, dst, parseWorkouts);
+}
+
+
+DataStore::DataStore()
+{
+    //TODO always assume changed
+    counter=0;
+    indexed=false;
+    changed=true;
+    backup=false;
+    backupKeep=20;
+    csvExport=false;
+    loadThreads=0;
+    lazyLoad=false;
+    storedId=0;
+    oldest=std::numeric_limits<int>::min();
+    printed=false;
+
+    journal = new Journal;
+    rewrite=false;
+    refill=false;
+    refilling=false;
+    pending=false;
+    compacted=0;
+    exporting=0;
+    database=0;
+
+    list = new WorkoutList;
+    edits=0;
+    autosaved=0;
+    exported=0;
+    autosaveEdits=0;
+}
+
+DataStore::~DataStore()
+{
+    compaction.waitForFinished();
+    delete journal;
+    delete database;
+}
+
+void DataStore::setDatabase(bool _database)
+{
+    if (_database && !database)
+    {
+        database = new SqlStore;
+    }
+    else if (!_database)
+    {
+        delete database;
+        database = 0;
+    }
+}
+
+bool DataStore::usingDatabase() const
+{
+    return database && database->isOpen();
+}
+
+// Native data file lives alongside the configured csv file
+QString DataStore::storeFile() const
+{
+    if (filename.isEmpty())
+        return filename;
+
+    QFileInfo info(filename);
+    if (info.suffix() == "pvd")
+        return filename;
+
+    return QString("%1/%2.pvd").arg(info.path()).arg(info.completeBaseName());
+}
+
+QString DataStore::journalFile() const
+{
+    if (filename.isEmpty())
+        return filename;
+    return storeFile() + ".journal";
+}
+
+QString DataStore::databaseFile() const
+{
+    if (filename.isEmpty())
+        return filename;
+
+    QFileInfo info(filename);
+    return QString("%1/%2.sqlite").arg(info.path()).arg(info.completeBaseName());
+}
+
+
+qint64 workoutKey(const QDate &date, const QTime &time)
+{
+    // invalid dates sort first
+    if (!date.isValid())
+        return std::numeric_limits<qint64>::min();
+    return date.toJulianDay() * 86400000 + (time.isValid() ? time.msecsSinceStartOfDay() : 0);
+}
+
+int sortfn(const Workout& lhs, const Workout &rhs)
+{
+    //    if (l == r) return lhs.set < rhs.set;
+    return lhs.start < rhs.start;
+}
+
+namespace {
+bool startLess(const Workout &w, qint64 start)
+{
+    return w.start < start;
+}
+
+bool lessStart(qint64 start, const Workout &w)
+{
+    return start < w.start;
+}
+
+// First row at or after start
+int lowerBound(const std::vector<Workout> &w, qint64 start)
+{
+    return std::lower_bound(w.begin(), w.end(), start, startLess) - w.begin();
+}
+
+// Start of workouts matched by a REMOVE_ALL key, see workoutKey()
+qint64 keyStart(qint64 key)
+{
+    return toStart(QDate::fromJulianDay(key / 86400000),
+                   QTime(0, 0).addMSecs(key % 86400000));
+}
+
+bool isSwim(const Workout &w)
+{
+    return w.type == TYPE_SWIM || w.type == TYPE_SWIMHR;
+}
+
+// FNV-1a over the bytes of each value
+struct Fnv
+{
+    Fnv() : h(14695981039346656037ULL) {}
+    void add(qint64 v)
+    {
+        for (int b = 0; b < 8; ++b, v >>= 8)
+            h = (h ^ (v & 0xff)) * 1099511628211ULL;
+    }
+    quint64 h;
+};
+
+// Has a set of at least distance
+bool coversDistance(const Workout &w, int distance)
+{
+    if (w.pool <= 0)
+        return false;
+
+    std::vector<Set>::const_iterator i;
+    for (i = w.sets.begin(); i != w.sets.end(); ++i)
+    {
+        if (i->lens * w.pool >= distance)
+            return true;
+    }
+    return false;
+}
+
+// journal is only worth folding in once it is this big
+const qint64 journal_limit = 256*1024;
+
+// Data files of a save, see DataStore::shardFile()
+struct StoreWrite
+{
+    StoreWrite() : all(false), sequence(0), backups(0), daily(false), refill(false) {}
+
+    QString store;
+    QList<int> years;
+    bool all; // every year in memory, the single file from before can go
+    quint64 sequence;
+    int backups;
+    bool daily; // only back up a year without one in the last day
+    QString database; // the same years written there too, empty if not used
+    bool refill; // everything in the database replaced
+};
+
+QString shardName(const QString &store, int year)
+{
+    QFileInfo info(store);
+    return QString("%1/%2-%3.pvd").arg(info.path()).arg(info.completeBaseName()).arg(year);
+}
+
+// Years with a data file next to store, the highest id and sequence in any
+QMap<int, quint64> findShards(const QString &store, int &lastId, quint64 &newest)
+{
+    QFileInfo info(store);
+    const QString prefix = info.completeBaseName() + "-";
+
+    QStringList filter;
+    filter << prefix + "*.pvd";
+
+    QMap<int, quint64> years;
+    const QDir dir(info.path());
+    const QStringList names = dir.entryList(filter, QDir::Files);
+    for (int i = 0; i < names.size(); ++i)
+    {
+        bool ok;
+        const int year = names[i].mid(prefix.size(), names[i].size() - prefix.size() - 4).toInt(&ok);
+        if (!ok)
+            continue;
+
+        // only the header is read, ids given out stay clear of every year
+        quint64 sequence = 0;
+        int last = 0;
+        if (ReadStoreHeader(dir.filePath(names[i]), &sequence, &last))
+        {
+            lastId = qMax(lastId, last);
+            newest = qMax(newest, sequence);
+        }
+        years.insert(year, 0);
+    }
+    return years;
+}
+
+// First start in year, workouts without a date come before year 1
+qint64 yearStart(int year)
+{
+    return year == 0 ? NO_START : toStart(QDate(year, 1, 1), QTime(0, 0));
+}
+
+// yearStart() as a bound of a range of years [from, to), see DataStore::oldest
+qint64 rangeStart(int year)
+{
+    if (year <= 0)
+        return NO_START;
+    if (year == std::numeric_limits<int>::max())
+        return std::numeric_limits<qint64>::max();
+    return yearStart(year);
+}
+
+// Same years in the database, only once their files are written so it
+// never gets ahead of them
+bool writeDatabase(const StoreWrite &write, const std::vector<Workout> &workouts)
+{
+    SqlStore::Ranges ranges;
+    if (write.refill)
+        ranges << qMakePair(NO_START, std::numeric_limits<qint64>::max());
+    else
+    {
+        for (int i = 0; i < write.years.size(); ++i)
+            ranges << qMakePair(yearStart(write.years[i]), yearStart(write.years[i] + 1));
+    }
+    if (ranges.isEmpty())
+        return true;
+
+    // opened here, a connection only works on the thread that made it
+    SqlStore database;
+    return database.open(write.database) && database.write(workouts, ranges, write.sequence);
+}
+
+bool writeStore(const StoreWrite &write, const std::vector<Workout> &workouts)
+{
+    bool ok = true;
+    for (int i = 0; i < write.years.size(); ++i)
+    {
+        const int year = write.years[i];
+        const QString shard = shardName(write.store, year);
+
+        // Keep the previous file, only what changed since the last backup is written
+        const QString backups = shard + ".backups";
+        const QDateTime backedUp = write.daily ? LastBackup(backups) : QDateTime();
+        if (write.backups > 0 && QFile::exists(shard) &&
+            (!backedUp.isValid() || backedUp.addDays(1) <= QDateTime::currentDateTime()))
+        {
+            BackupFile(shard, backups, write.backups);
+            // should we fail if a backup cannot be performed?
+        }
+
+        // a failed write leaves the old file intact
+        const Workout *rows = workouts.data();
+        const int first = lowerBound(workouts, yearStart(year));
+        const int last = lowerBound(workouts, yearStart(year + 1));
+        ok = SaveStore(shard, rows + first, rows + last, write.sequence) && ok;
+    }
+
+    if (ok && write.all)
+        QFile::remove(write.store);
+    if (ok && !write.database.isEmpty())
+        ok = writeDatabase(write, workouts);
+    return ok;
+}
+
+bool writeCSV(const QString &file, const std::vector<Workout> &workouts)
+{
+    QSaveFile out_file(file);
+    if (!out_file.open(QIODevice::WriteOnly|QIODevice::Text))
+        return false;
+
+    CsvWriter out(out_file);
+    out << csv_header;
+
+    // one row at a time, the dataset isn't copied
+    ExerciseSet row;
+    std::vector<Workout>::const_iterator i;
+    for (i = workouts.begin(); i != workouts.end(); ++i)
+    {
+        for (size_t j = 0; j < i->sets.size(); ++j)
+        {
+            setToRow(*i, i->sets[j], j + 1, row);
+            writeRow(out, row);
+        }
+    }
+
+    return out.flush() && out_file.commit();
+}
+
+// Background save, an empty store or csv name is skipped
+bool writeSnapshot(StoreWrite store, WorkoutSnapshot snapshot, QString csv)
+{
+    bool ok = true;
+    if (!store.store.isEmpty())
+        ok = writeStore(store, snapshot.workouts());
+    if (!csv.isEmpty())
+        ok = writeCSV(csv, snapshot.workouts()) && ok;
+    return ok;
+}
+} //namespace
+
+QString DataStore::shardFile(int year) const
+{
+    if (filename.isEmpty())
+        return filename;
+    return shardName(storeFile(), year);
+}
+
+bool DataStore::load()
+{
+    compaction.waitForFinished();
+    finishCompaction();
+    journal->close();
+
+    list = new WorkoutList;
+    aggregates.clear();
+    prints.clear();
+    printed=false;
+    autosaved = exported = edits;
+
+    indexed=false;
+    changed=false;
+    rewrite=false;
+    refill=false;
+    error.clear();
+    dirty.clear();
+    shards.clear();
+    storedId=0;
+    oldest=std::numeric_limits<int>::min();
+
+    const QString store = storeFile();
+    QMap<int, quint64> sequences; // of the years read
+    quint64 sequence = 0; // of any year without a file
+    quint64 newest = 0; // of any data file
+    bool loaded = false;
+    if (!filename.isEmpty())
+        shards = findShards(store, storedId, newest);
+
+    // The database is read in place of the data files while it is in
+    // step with them. It is left alone while turned off, once back on
+    // it is filled again from the files.
+    bool stored = false;
+    if (database && database->open(databaseFile()) && !database->isEmpty())
+        stored = database->sequence() >= newest && !QFile::exists(store);
+
+    // A single file from before years were split, written out by year on save
+    if (QFile::exists(store))
+    {
+        loaded = ReadStore(store, workouts(), &sequence, lazyLoad);
+        if (loaded)
+            rewrite = changed = true;
+        else
+        {
+            workouts().clear();
+            sequence = 0;
+        }
+    }
+    else if (stored)
+    {
+        // Ahead of the data files only if some were lost, every year is
+        // then read to write them again
+        sequence = database->sequence();
+        const bool lost = sequence > newest || shards.isEmpty();
+        int from = qMin(QDate::currentDate().year(), shardYear(database->lastStart())) - 1;
+        if (csvExport || lost)
+            from = std::numeric_limits<int>::min();
+
+        loaded = readDatabase(from, std::numeric_limits<int>::max(), workouts());
+        if (loaded)
+        {
+            oldest = from;
+            if (lost)
+                rewrite = changed = true;
+        }
+        else
+        {
+            // the data files are read instead
+            workouts().clear();
+            sequence = 0;
+            stored = false;
+        }
+    }
+
+    if (!loaded && !QFile::exists(store) && !shards.isEmpty())
+    {
+        // The newest year and the one before, the csv copy and a
+        // database being filled need everything
+        int from = qMin(QDate::currentDate().year(), shards.lastKey()) - 1;
+        if (csvExport || usingDatabase())
+            from = std::numeric_limits<int>::min();
+
+        loaded = readShards(from, std::numeric_limits<int>::max(), workouts(), &sequences);
+        if (loaded)
+            oldest = from;
+        else
+        {
+            workouts().clear();
+            sequences.clear();
+        }
+    }
+
+    // No native file yet, import the csv and write it out on save
+    if (!loaded)
+    {
+        if (!ReadCSV(qPrintable(filename), workouts(), loadThreads))
+            return false;
+        rewrite = changed = !workouts().empty();
+    }
+
+    // Rows imported from csv get ids, written out on save
+    if (assignIds())
+        rewrite = changed = true;
+
+    // Pick up changes made since the data files were last written
+    bool older = false;
+    replay(sequences, sequence, older);
+    if (older)
+    {
+        // a change to a year still on disk, start again with all of them
+        list = new WorkoutList;
+        dirty.clear();
+        sequences.clear();
+        oldest = std::numeric_limits<int>::min();
+        const bool read = stored ?
+                    readDatabase(oldest, std::numeric_limits<int>::max(), workouts()) :
+                    readShards(oldest, std::numeric_limits<int>::max(), workouts(), &sequences);
+        if (!read)
+        {
+            workouts().clear();
+            return false;
+        }
+        assignIds();
+        replay(sequences, sequence, older);
+    }
+    assignIds();
+
+    // Only time the whole list is sorted, later changes keep it in order
+    if (!std::is_sorted(workouts().begin(), workouts().end(), sortfn))
+        std::stable_sort(workouts().begin(), workouts().end(), sortfn);
+    aggregates.reset(Workouts());
+
+    if (!filename.isEmpty())
+    {
+        // journal numbering carries on after every file, read or not
+        sequence = qMax(sequence, newest);
+        QMap<int, quint64>::const_iterator s;
+        for (s = sequences.begin(); s != sequences.end(); ++s)
+            sequence = qMax(sequence, s.value());
+
+        // One in another format is left alone, changes are then saved in full
+        if (!journal->open(journalFile(), sequence))
+            error = tr("The journal %1 could not be opened and was left as it is. "
+                       "Changes will be saved to the data file in full.").arg(journalFile());
+    }
+    emit workoutsReset();
+
+    // First use of the database, or behind the data files, filled in the background
+    if (usingDatabase() && !stored)
+    {
+        refill = changed = true;
+        saveInBackground(true);
+    }
+    return true;
+}
+
+bool DataStore::readShards(int from, int to, std::vector<Workout>& dst, QMap<int, quint64> *sequences)
+{
+    QMap<int, quint64>::iterator i;
+    for (i = shards.lowerBound(from); i != shards.end() && i.key() < to; ++i)
+    {
+        if (!ReadStore(shardFile(i.key()), dst, &i.value(), lazyLoad))
+            return false;
+        if (sequences)
+            sequences->insert(i.key(), i.value());
+    }
+    return true;
+}
+
+// Years [from, to) from the database, in start order
+bool DataStore::readDatabase(int from, int to, std::vector<Workout>& dst)
+{
+    const size_t first = dst.size();
+    if (!database->read(dst, rangeStart(from), rangeStart(to)))
+        return false;
+    std::stable_sort(dst.begin() + first, dst.end(), sortfn);
+    return true;
+}
+
+bool DataStore::loadFrom(const QDate &date)
+{
+    const int from = date.isValid() ? date.year() : std::numeric_limits<int>::min();
+    if (from >= oldest)
+        return false;
+
+    compaction.waitForFinished();
+    finishCompaction();
+
+    // only read from the database while in step with the data files
+    std::vector<Workout> added;
+    const bool read = usingDatabase() ? readDatabase(from, oldest, added) :
+                                        readShards(from, oldest, added);
+    if (!read)
+        return false;
+    oldest = from;
+    if (added.empty())
+        return false;
+
+    // all earlier than the years in memory
+    workouts().insert(workouts().begin(), added.begin(), added.end());
+    indexed=false;
+
+    std::vector<Workout>::const_iterator i;
+    for (i = added.begin(); i != added.end(); ++i)
+        track(*i);
+
+    emit workoutsReset();
+    return true;
+}
+
+int DataStore::shardYear(qint64 start)
+{
+    return start == NO_START ? 0 : startDate(start).year();
+}
+
+QList<int> DataStore::takeDirty()
+{
+    QSet<int> years = dirty;
+    dirty.clear();
+
+    if (rewrite)
+    {
+        // and any on disk now left empty
+        std::vector<Workout>::const_iterator i;
+        for (i = Workouts().begin(); i != Workouts().end(); ++i)
+            years.insert(shardYear(i->start));
+
+        QMap<int, quint64>::const_iterator s;
+        for (s = shards.lowerBound(oldest); s != shards.end(); ++s)
+            years.insert(s.key());
+    }
+
+    QList<int> sorted = years.values();
+    std::sort(sorted.begin(), sorted.end());
+    decodeYears(sorted);
+    return sorted;
+}
+
+void DataStore::decodeYears(const QList<int> &years)
+{
+    for (int y = 0; y < years.size(); ++y)
+    {
+        const int first = lowerBound(Workouts(), yearStart(years[y]));
+        const int last = lowerBound(Workouts(), yearStart(years[y] + 1));
+        for (int r = first; r < last; ++r)
+        {
+            if (!Workouts()[r].table.isDecoded())
+                workouts()[r].table = Workouts()[r].table.decoded();
+        }
+    }
+}
+
+// Give unique ids to workouts without one, true if any were assigned
+bool DataStore::assignIds()
+{
+    counter = storedId;
+    std::vector<Workout>::iterator i;
+    for (i=workouts().begin(); i != workouts().end(); ++i)
+        counter = qMax(counter, i->id);
+
+    QSet<int> seen;
+    bool assigned = false;
+    for (i=workouts().begin(); i != workouts().end(); ++i)
     {
-        QTextStream out(&file);
+        if (i->id <= 0 || seen.contains(i->id))
+        {
+            i->id = ++counter;
+            assigned = true;
+        }
+        seen.insert(i->id);
+    }
+    if (assigned)
+        indexed = false;
+    return assigned;
+}
 
-        //New format
-        out << "User Number,Date,Time,Type,Pool Length,,Duration,Calories,Total Laps,Total Distance,Set Number,Set Duration,Average Strokes,Distance,Speed,Efficiency,Stroke Rate,,,,,,Watch Version,Status,Notes\n";
+// Entries are applied to years whose file is older than them. Sets
+// older, and stops, at one for a year not in memory.
+void DataStore::replay(const QMap<int, quint64> &sequences, quint64 base, bool &older)
+{
+    const bool all = oldest == std::numeric_limits<int>::min();
+    older = false;
 
-        std::vector<ExerciseSet>::iterator i;
+    std::vector<Journal::Entry> entries;
+    int version = 0;
+    if (filename.isEmpty() || !Journal::read(journalFile(), 0, entries, &version) ||
+        version != Journal::format)
+        return;
 
-        for (i=exercises.begin(); i != exercises.end(); ++i)
+    std::vector<Journal::Entry>::const_iterator e;
+    for (e=entries.begin(); e != entries.end(); ++e)
+    {
+        if (e->op == Journal::ADD || e->op == Journal::REPLACE || e->op == Journal::REMOVE_ALL)
         {
-            out << i->user << ","
-                << i->date.toString("d/M/yyyy") << ","
-                << i->time.toString("hh:mm:ss") << ",";
-            if (i->type == "Swim" || i->type == "SwimHR")
+            const qint64 start = e->op == Journal::REMOVE_ALL ? keyStart(e->key) : e->workout.start;
+            if (shardYear(start) < oldest)
             {
-                out << i->type << ","
-                    << i->pool << ",";
-                //                    << i->unit << ","
-                // This field is now unused so we'll use this one to insert custom lap styles
-                if (i->len_style.size())
-                {
-                    uint l;
-                    for (l=0; l < i->len_style.size(); l++) {
-                        out << i->len_style[l] << ";";
-                    }
-                    out << ",";
-                }
-                else
-                {
-                    out << ",";
-                }
+                older = true;
+                return;
+            }
+        }
 
-                out << i->totalduration.toString("hh:mm:ss") << ","
-                    << i->cal << ","
-                    << i->lengths << ","
-                    << i->totaldistance << ","
-                    << i->set << ","
-                    << i->duration.toString("hh:mm:ss") << ","
-                    << i->strk << ","
-                    << i->lens << ","
-                    << i->speed << ","
-                    << i->effic << ","
-                    << i->rate << ","
-                    << "Free" << ",";
-
-                //1,31/3/2015,06:38:12,SwimHR,25,,00:32:38,397,52,1300,1,00:06:19,12,12,126,44,22,Free,
-                //,,,,0,New,00:32:38,,STARTOFLAPDATA,0,0,0,3908.923,00:14,SwimHR,11,-1,
-                //28,12,31,13,31.125,13,31.625,13,31.25,13,31.125,13,29.5,11,33.375,13,30.375,13,31.75,12,33.125,13,33,13
-                if (i->type == "SwimHR")
+        if (e->op == Journal::ADD)
+        {
+            if (e->seq > sequences.value(shardYear(e->workout.start), base))
+            {
+                workouts().push_back(e->workout);
+                touch(e->workout.start);
+            }
+            continue;
+        }
+
+        if (e->op == Journal::SYNC)
+        {
+            QSet<int> ids;
+            for (size_t n = 0; n < e->ids.size(); ++n)
+                ids.insert(e->ids[n]);
+
+            int found = 0;
+            std::vector<Workout>::iterator i;
+            for (i = workouts().begin(); i != workouts().end(); ++i)
+            {
+                if (!ids.contains(i->id))
+                    continue;
+                ++found;
+                if (e->seq > sequences.value(shardYear(i->start), base))
                 {
-                    QString sync;
-                    if (i->sync & SYNC_GARMIN)
-                        sync += "G";
-                    if (i->sync & SYNC_STRAVA)
-                        sync += "S";
-                    if (i->sync & SYNC_FIT)
-                        sync += "F";
-
-                    out << ",,,,0,New," //Can mark edited values
-                        << i->totalduration.toString("hh:mm:ss") << ","
-
-                           //Only interested in syncing SwimHR data so insert sync status flags here
-                        << sync
-
-                        << ",STARTOFLAPDATA,0,0,0,"
-                           //<< i->num << ","
-                        << QString::number(i->num,'f',3)  << ","
-                        << i->rest.toString("mm:ss") << ","
-                        << i->type << ","
-                        << i->lens-1 << ","
-                        << "-1";
-
-                    int l;
-                    for (l=0; l<i->lens; ++l)
-                    {
-                        out << "," << i->len_time[l];
-                        out << "," << i->len_strokes[l];
-                    }
-
-                    out << "\n";
+                    i->sync |= e->key;
+                    touch(i->start);
                 }
-                else
+            }
+
+            // some in a year still on disk
+            if (found < ids.size() && !all)
+            {
+                older = true;
+                return;
+            }
+            continue;
+        }
+
+        bool found = false;
+        std::vector<Workout>::iterator i = workouts().begin();
+        while (i != workouts().end())
+        {
+            const qint64 key = e->op == Journal::REMOVE_ALL ?
+                        workoutKey(startDate(i->start), startTime(i->start)) : i->id;
+            if (key != e->key)
+            {
+                ++i;
+                continue;
+            }
+
+            found = true;
+            if (e->seq <= sequences.value(shardYear(i->start), base))
+            {
+                // already in its file
+                if (e->op == Journal::REMOVE_ALL)
                 {
-                    out << ",,,,210,,,\n";
+                    ++i;
+                    continue;
                 }
+                break;
             }
-            else
+
+            touch(i->start);
+            if (e->op == Journal::REPLACE)
             {
-                out << i->type << ","
-                    << ",,"
-                    << i->totalduration.toString("hh:mm:ss") << ","
-                    << ",,,"
-                    << i->set << ","
-                    << i->duration.toString("hh:mm:ss") << ","
-                    << ",,,,,,";
-                out << ",,,,210,,,\n";
+                *i = e->workout;
+                touch(i->start);
+                break;
             }
+            i = workouts().erase(i);
+            if (e->op == Journal::REMOVE)
+                break;
+        }
+
+        // by id, so in a year still on disk
+        if (!found && !all && e->op != Journal::REMOVE_ALL)
+        {
+            older = true;
+            return;
         }
     }
-    return true;
 }
 
-//
-bool ReadCSV( const std::string & name, std::vector<ExerciseSet>& dst )
+void DataStore::log(int op, qint64 key, const Workout *workout)
 {
-    // Simplistic csv format reading
-    QFile file(name.c_str());
-    if (file.open(QIODevice::ReadOnly))
-    {
-        QTextStream in(&file);
+    record(op, key, workout);
+    saveIfDue();
+}
 
-        bool oldformat = false;
-        QString head = in.readLine(); //skip header
-        if (head.contains("LogDate"))
-        {
-            oldformat = true;
-        }
+void DataStore::record(int op, qint64 key, const Workout *workout)
+{
+    changed=true;
+    ++edits;
 
-        while (!in.atEnd())
-        {
-            QString line = in.readLine();
-            QStringList strings = line.split(",");
+    // Without a journal everything has to be written on save
+    if (!journal->append(op, key, workout))
+        rewrite=true;
+}
 
-            if (strings.count())
-            {
-                ExerciseSet e;
+// Only called when the list and journal agree, a snapshot taken now
+// covers every journal entry so far
+void DataStore::saveIfDue()
+{
+    finishCompaction();
+
+    if (journal->isOpen() && journal->size() > journal_limit)
+        compact(false);
+    else if (autosaveEdits > 0 && edits - autosaved >= (quint64)autosaveEdits)
+        autosave();
+}
 
-                e.sync=0;
-                e.user = strings.value(0).toInt();
-                e.date = QDate::fromString( strings.value(1), QString("d/M/yyyy"));
-                e.time = QTime::fromString( strings.value(2));
+bool DataStore::compact(bool wait)
+{
+    if (compaction.isRunning())
+    {
+        if (!wait)
+            return true;
+        compaction.waitForFinished();
+    }
+    finishCompaction();
 
-                e.type = strings.value(3);
-                e.totalduration = QTime::fromString(strings.value(6));
-                e.set = strings.value(10).toInt();
-                e.duration = QTime::fromString( strings.value(11));
+    const QString store = storeFile();
+    const quint64 sequence = journal->sequence();
 
-                if (e.type == "Swim" || e.type == "SwimHR")
-                {
-                    e.pool = strings.value(4).toInt();
-                    // e.unit = strings.value(5); //no longer used
-                    e.cal = strings.value(7).toInt();
-                    e.lengths = strings.value(8).toInt();
-                    e.totaldistance = strings.value(9).toInt();
-                    e.strk = strings.value(12).toInt();
-                    e.lens  = strings.value(13).toInt();
-
-                    if (oldformat && e.lens && e.pool) //if we've saved as an oldformat file update to new
-                    {
-                        e.lens = strings.value(13).toInt() / e.pool;
-                    }
-                    e.dist = e.lens * e.pool;
-                    e.speed  = strings.value(14).toInt();
-                    e.effic = strings.value(15).toInt();
-                    e.rate  = strings.value(16).toInt();
-
-                    if (e.lens == 0) //Duplicate swimovate data
-                    {
-                        e.speed = 0;
-                        e.rate = 0;
-                        e.effic = e.strk;
-                    }
-                }
+    if (wait)
+    {
+        StoreWrite write;
+        write.store = store;
+        write.all = rewrite && oldest == std::numeric_limits<int>::min();
+        write.years = takeDirty();
+        write.sequence = sequence;
+        write.backups = backups();
+        if (usingDatabase())
+        {
+            // written along with the data files, in full only with every year in memory
+            write.database = databaseFile();
+            write.refill = refill && oldest == std::numeric_limits<int>::min();
+        }
+        if (!writeStore(write, Workouts()))
+        {
+            // years taken above are written next time with the rest
+            rewrite=true;
+            return false;
+        }
+        rewrite=false;
+        if (write.refill)
+            refill=false;
+        journal->discard(sequence);
+        if (!journal->isOpen())
+            journal->open(journalFile(), sequence);
+        return true;
+    }
 
-                //1,31/3/2015,06:38:12,SwimHR,25,,00:32:38,397,52,1300,1,00:06:19,12,12,126,44,22,Free,,,,,0,
-                //New,00:32:38,,STARTOFLAPDATA,
-                //0,0,0,3908.923,00:14,SwimHR,
-                //11,-1,28,12,31,13,31.125,13,31.625,13,31.25,13,31.125,13,29.5,11,33.375,13,30.375,13,31.75,12,33.125,13,33,13
-                //Ignore HR part of data for now.
+    saveInBackground(true);
+    return true;
+}
 
-                if (e.type == "HRChrono")
-                {
-                    if (strings.value(23) == "Deleted")
-                    {
-                        continue; //just drop deleted rows.
-                    }
-                }
+// Write the data file and csv copy from a snapshot so editing can carry
+// on meanwhile. The list is shared, not copied, until the next change.
+void DataStore::saveInBackground(bool store)
+{
+    const bool csv = csvOutdated();
+    if (!store && !csv)
+        return;
 
-                if (e.type == "SwimHR") // Read length data
-                {
-                    if (strings.value(23) == "Deleted")
-                    {
-                        continue; //just drop deleted rows.
-                    }
-
-                    e.sync=0;
-                    if (strings.value(25).contains('F'))
-                        e.sync |= SYNC_FIT;
-                    if (strings.value(25).contains('G'))
-                        e.sync |= SYNC_GARMIN;
-                    if (strings.value(25).contains('S'))
-                        e.sync |= SYNC_STRAVA;
-
-                    double num = strings.value(30).toDouble(); //no idea what this is
-                    e.num = num;
-                    e.rest = QTime::fromString( strings.value(31),"mm:ss");
-
-                    QStringList styles = strings.value(5).split(";");
-                    bool hasstyles=false;
-                    if (styles.count()>1)
-                    {
-                        hasstyles=true;
-                    }
-
-                    //Are we loading a file with the styles appended at the end?
-                    bool oldstyles = (strings.count() > 35+e.lens*2);
-                    int l;
-                    for (l = 0; l <e.lens; ++l)
-                    {
-                        double time = strings.value(35+l*2).toDouble();
-                        int strk = strings.value(36+l*2).toInt();
-
-                        QString style;
-                        if (oldstyles)
-                        {
-                            style = strings.value(35+e.lens*2+l);
-                        }
-                        else if (hasstyles)
-                        {
-                            style = styles.value(l);
-                        }
-
-                        e.len_time.push_back(time);
-                        e.len_strokes.push_back(strk);
-                        if (hasstyles || oldstyles)
-                            e.len_style.push_back(style);
-                    }
-
-                    //Check we have nothing but empty styles
-                    uint j;
-                    bool empty=true;
-                    for (j=0; j < e.len_style.size(); j++) {
-                        if (e.len_style[j].length())
-                            empty=false;
-                    }
-                    if (empty)
-                        e.len_style.clear();
-                }
-                dst.push_back(e);
-            }
+    StoreWrite write;
+    write.sequence = journal->sequence();
+    if (store)
+    {
+        write.store = storeFile();
+        write.all = rewrite && oldest == std::numeric_limits<int>::min();
+        write.years = takeDirty();
+        write.backups = backups();
+        write.daily = true; // autosave and compaction, not just on exit
+        if (usingDatabase())
+        {
+            write.database = databaseFile();
+            write.refill = refill && oldest == std::numeric_limits<int>::min();
         }
-
     }
-    return true;
+
+    compaction = QtConcurrent::run(writeSnapshot, write, snapshot(), csv ? filename : QString());
+    pending = true;
+    compacted = store ? write.sequence : 0;
+    exporting = csv ? edits : 0;
+    refilling = write.refill;
+    if (store)
+        rewrite=false;
 }
 
+// Drop journal entries a finished background write has covered
+void DataStore::finishCompaction()
+{
+    if (!pending || !compaction.isFinished())
+        return;
 
+    if (compaction.result())
+    {
+        if (compacted)
+            journal->discard(compacted);
+        if (exporting)
+            exported = exporting;
+        if (refilling)
+            refill=false;
+    }
+    else if (compacted)
+    {
+        rewrite=true;
+    }
+    pending=false;
+    compacted=0;
+    exporting=0;
+    refilling=false;
+}
 
-DataStore::DataStore()
+// Only ever a copy of every year
+bool DataStore::csvOutdated() const
 {
-    //TODO always assume changed
-    counter=0;
-    sorted=false;
-    changed=true;
-    backup=false;
+    return csvExport && storeFile() != filename && exported != edits &&
+            oldest == std::numeric_limits<int>::min();
 }
 
-namespace {
-// import
-void setsToWorkouts( const std::vector<ExerciseSet>& sets,
-                     std::vector<Workout>& workouts)
+void DataStore::autosave()
 {
-    std::vector<ExerciseSet>::const_iterator i;
+    if (autosaved == edits && !rewrite && !refill)
+        return;
+
+    // try again next time rather than wait
+    finishCompaction();
+    if (compaction.isRunning())
+        return;
+    autosaved = edits;
+
+    // The journal already holds each change, only a store without one
+    // needs writing in full. The database is brought up to date each time.
+    saveInBackground(rewrite || refill || !journal->isOpen() ||
+                     (usingDatabase() && !dirty.isEmpty()));
+}
 
-    for (i=sets.begin(); i != sets.end();)
-    {
-        Workout wrk;
-        wrk.user = i->user;
-        wrk.date = i->date;
-        wrk.time = i->time;
-        wrk.type = i->type;
-        wrk.pool = i->pool;
-        wrk.unit = i->unit;
-        wrk.totalduration = i->totalduration;
-        wrk.cal = i->cal;
-        wrk.lengths = i->lengths;
-        wrk.totaldistance = i->totaldistance;
-        wrk.sync = i->sync;
-
-        QDateTime td(i->date, i->time);
-        std::vector<ExerciseSet>::const_iterator j;
-        j=i;
-        int n=0;
-        QTime rest;
-        int total=0;
-
-        int min_effic=999;
-        int avg_effic=0;
-        int max_effic=0;
-
-        while( j != sets.end() &&
-               td == QDateTime(j->date, j->time) )
-        {
-            Set set;
-            set.set = ++n;
-            total += QTime(0,0,0).secsTo(j->duration);
-
-            set.duration = j->duration;
-            set.lens = j->lens;
-            set.strk = j->strk;
-            set.dist = j->dist;
-            set.speed = j->speed;
-            set.effic = j->effic;
-            set.rate = j->rate;
-            set.rest = j->rest;
-
-            if (set.rest.isValid()) // Only set rest data from live
-            {
-                if (!rest.isValid())
-                    rest = set.rest;
-                else
-                    rest = rest.addSecs(QTime(0,0,0).secsTo(set.rest));
-            }
-            set.num = j->num;
+bool DataStore::save()
+{
+    changed=false;
 
-            set.times = j->len_time;
-            set.strokes = j->len_strokes;
-            set.styles = j->len_style;
+    compaction.waitForFinished();
+    finishCompaction();
 
-            if (set.effic > 0 && set.effic < min_effic) min_effic = set.effic;
-            if (set.effic > max_effic) max_effic = set.effic;
+    if (csvOutdated() && exportCSV(filename))
+        exported = edits;
 
-            avg_effic += set.effic;
+    // Changes are already on disk in the journal
+    if (!rewrite && !refill && journal->isOpen())
+        return true;
 
-            wrk.sets.push_back(set);
-            ++j;
-        }
+    return compact(true);
+}
 
-        if (!rest.isValid())
-            rest = QTime(0,0,0).addSecs(QTime(0,0,0).secsTo(i->totalduration) - total);
+bool DataStore::exportCSV(const QString &file)
+{
+    loadAll();
+    return writeCSV(file, Workouts());
+}
 
-        wrk.rest = rest;
-        wrk.min_eff = min_effic;
-        wrk.avg_eff = avg_effic / wrk.sets.size();
-        wrk.max_eff = max_effic;
+//Find first exercise at date
+int DataStore::findExercise(QDate dt)
+{
+    if (!dt.isValid())
+        return -1;
+
+    const std::vector<Workout> &w = Workouts();
+    const qint64 day = toStart(dt, QTime(0,0));
+    int row = lowerBound(w, day);
+    if (row < (int)w.size() && w[row].start < day + 86400)
+        return row;
+    return -1;
+}
+
+int DataStore::findExercise(QDateTime dt)
+{
+    const std::vector<Workout> &w = Workouts();
+    const qint64 start = toStart(dt);
+    int row = lowerBound(w, start);
+    if (row < (int)w.size() && w[row].start == start)
+        return row;
+    return -1;
+}
 
-        workouts.push_back(wrk);
-        i = j;
+int DataStore::findWorkout(int id) const
+{
+    const std::vector<Workout> &w = Workouts();
+    if (!indexed)
+    {
+        index.clear();
+        index.reserve(w.size());
+        for (size_t row = 0; row < w.size(); ++row)
+            index.insert(w[row].id, row);
+        indexed = true;
     }
+    return index.value(id, -1);
 }
 
+const Workout* DataStore::getWorkout(int id) const
+{
+    const int row = findWorkout(id);
+    return row < 0 ? 0 : &Workouts()[row];
+}
 
-// export
-void workoutsToSets( const std::vector<Workout>& workouts,
-                     std::vector<ExerciseSet>& sets )
+void DataStore::remove(int id)
 {
-    std::vector<Workout>::const_iterator i;
+    const int row = findWorkout(id);
+    if (row < 0)
+        return;
+
+    touch(Workouts()[row].start);
+    untrack(Workouts()[row]);
+    workouts().erase(workouts().begin()+row);
+    indexed=false;
+    log(Journal::REMOVE, id);
+    emit workoutRemoved(row);
+}
 
-    for (i = workouts.begin(); i != workouts.end(); ++i)
-    {
-        std::vector<Set>::const_iterator j;
+void DataStore::removeSet(int wid, int sid)
+{
+    const int row = findWorkout(wid);
+    if (row < 0)
+        return;
+
+    Workout &w = workouts()[row];
+    untrack(w);
+    w.removeSet(sid);
+    track(w);
+    touch(w.start);
+    log(Journal::REPLACE, wid, &w);
+    emit workoutModified(row);
+}
 
-        int setcount = 1;
-        for (j = i->sets.begin(); j!= i->sets.end(); ++j)
-        {
-            ExerciseSet s;
+// Remove all exercises at date
+void DataStore::remove( QDateTime dt )
+{
+    loadFrom(dt.date());
 
-            s.user = i->user;
-            s.date = i->date;
-            s.time = i->time;
-            s.type = i->type;
-            s.pool = i->pool;
-            s.unit = i->unit;
-            s.totalduration = i->totalduration;
-            s.cal = i->cal;
-            s.lengths = i->lengths;
-            s.totaldistance = i->totaldistance;
-            s.sync = i->sync;
+    WorkoutQuery at;
+    at.from = toStart(dt);
+    at.to = at.from + 1;
 
-            //Recalc setids in case of deletions for compatibility with Poolmate software
-            s.set = setcount++; //j->set;
-            s.duration = j->duration;
-            s.lens = j->lens;
-            s.strk = j->strk;
-            s.dist = j->dist;
-            s.speed = j->speed;
-            s.effic = j->effic;
-            s.rate = j->rate;
-            s.rest = j->rest;
-            s.num = j->num;
+    int row;
+    const std::vector<int> ids = take(at, row);
+    if (ids.empty())
+        return;
 
-            s.len_time = j->times;
-            s.len_strokes = j->strokes;
-            s.len_style = j->styles;
+    log(Journal::REMOVE_ALL, workoutKey(dt.date(), dt.time()));
+    sendRemoved(ids.size(), row);
+}
 
-            sets.push_back(s);
-        }
-    }
+int DataStore::remove( const WorkoutQuery &query )
+{
+    loadFrom(startDate(query.from));
+
+    int row;
+    const std::vector<int> ids = take(query, row);
+    if (ids.empty())
+        return 0;
+
+    // all logged before any background save can start
+    std::vector<int>::const_iterator i;
+    for (i = ids.begin(); i != ids.end(); ++i)
+        record(Journal::REMOVE, *i, 0);
+    saveIfDue();
+
+    sendRemoved(ids.size(), row);
+    return ids.size();
 }
-} //namespace
 
-bool DataStore::load()
+// Close up the rows kept over the ones matched in a single pass, then
+// drop the tail. Returns the ids taken, row is where the first was.
+std::vector<int> DataStore::take( const WorkoutQuery &query, int &row )
 {
-    workouts.empty();
+    std::vector<int> ids;
+    row = -1;
 
-    sorted=false;
-    changed=false;
+    // nothing to do, don't copy a list a background save shares
+    if (this->query(query).empty())
+        return ids;
 
-    std::vector<ExerciseSet> input;
-    if ( ReadCSV(qPrintable(filename), input))
+    std::vector<Workout> &w = workouts();
+    const int first = lowerBound(w, query.from);
+    const int last = qMax(first, lowerBound(w, query.to));
+
+    int out = first;
+    for (int in = first; in < last; ++in)
     {
-        setsToWorkouts(input, workouts);
-        return true;
+        if (query.matches(w[in]))
+        {
+            if (ids.empty())
+                row = in;
+            ids.push_back(w[in].id);
+            touch(w[in].start);
+            untrack(w[in]);
+            continue;
+        }
+        if (out != in)
+            std::swap(w[out], w[in]);
+        ++out;
     }
-    return false;
+    w.erase(w.begin() + out, w.begin() + last);
+    indexed=false;
+    return ids;
 }
 
-bool DataStore::save()
+// One row is patched, more are too many to list
+void DataStore::sendRemoved( size_t count, int row )
 {
-    changed=false;
+    if (count == 1)
+        emit workoutRemoved(row);
+    else if (count > 1)
+        emit workoutsReset();
+}
+
+int DataStore::add(const std::vector<ExerciseSet> &sets)
+{
+    std::vector<Workout> added;
+    setsToWorkouts( sets,  added);
+    if (added.empty())
+        return -1;
+
+    // Merge the new workouts into place rather than sorting everything
+    std::stable_sort(added.begin(), added.end(), sortfn);
+    loadFrom(startDate(added.front().start));
 
-    if (backup)
+    int id = -1;
+    std::vector<Workout>::iterator i;
+    for (i=added.begin(); i != added.end(); ++i)
     {
-        QDateTime now = QDateTime::currentDateTime();
-        QString dateSuffix = now.toString("_yyyy-MM-dd_HH-mm-ss");
-        QString backupName = qPrintable(filename) + dateSuffix;
-        QFile::copy(qPrintable(filename), backupName);
-        // should we fail if a backup cannot be performed?
+        id = i->id = ++counter;
+        touch(i->start);
+        track(*i);
     }
 
-    std::vector<ExerciseSet> output;
-    workoutsToSets(workouts, output);
-    return SaveCSV(qPrintable(filename), output );
+    const size_t mid = workouts().size();
+    workouts().insert(workouts().end(), added.begin(), added.end());
+    std::inplace_merge(workouts().begin(), workouts().begin() + mid, workouts().end(), sortfn);
+    indexed=false;
+
+    // all logged before any background save can start
+    for (i=added.begin(); i != added.end(); ++i)
+        record(Journal::ADD, i->id, &*i);
+    saveIfDue();
+
+    // One row is patched, more are too many to list
+    if (added.size() == 1)
+        emit workoutInserted(findWorkout(id));
+    else
+        emit workoutsReset();
+
+    return id;
 }
 
-//Find first exercise at date
-int DataStore::findExercise(QDate dt)
+std::vector<int> DataStore::findSwims(qint64 from, qint64 to, int distance) const
 {
-    std::vector<Workout>::iterator i;
-    int row=0;
+    std::vector<int> rows;
+
+    WorkoutQuery swims = WorkoutQuery::swims();
+    swims.from = from;
+    swims.to = to;
+    swims.distance = distance;
+
+    const WorkoutView view = query(swims);
+    WorkoutView::const_iterator i;
+    for (i = view.begin(); i != view.end(); ++i)
+        rows.push_back(i.row());
+    return rows;
+}
 
-    for (i=workouts.begin(); i != workouts.end(); ++i)
-    {
-        if (i->date == dt)
-            return row;
-        row++;
-    }
-    return -1;
+WorkoutView DataStore::query(const WorkoutQuery &query) const
+{
+    return WorkoutView(Workouts(), query);
 }
 
-int DataStore::findExercise(QDateTime dt)
+WorkoutView WorkoutSnapshot::query(const WorkoutQuery &query) const
 {
-    std::vector<Workout>::iterator i;
-    int row=0;
+    return WorkoutView(workouts(), query);
+}
 
-    for (i=workouts.begin(); i != workouts.end(); ++i)
-    {
-        QDateTime td(i->date, i->time);
+// Only the rows in the date range are looked at
+WorkoutView::WorkoutView(const std::vector<Workout> &_rows, const WorkoutQuery &_query)
+    : rows(&_rows), query(_query)
+{
+    first = lowerBound(_rows, query.from);
+    last = qMax(first, lowerBound(_rows, query.to));
+}
 
-        if (td == dt)
-            return row;
-        row++;
-    }
-    return -1;
+WorkoutQuery::WorkoutQuery()
+    : from(NO_START), to(std::numeric_limits<qint64>::max()), types(0),
+      pool(0), distance(0), syncMask(0), sync(0)
+{
 }
 
-int sortfn(const Workout& lhs, const Workout &rhs)
+WorkoutQuery WorkoutQuery::swims()
 {
-    QDateTime l(lhs.date, lhs.time);
-    QDateTime r(rhs.date, rhs.time);
+    WorkoutQuery q;
+    q.types = (1 << TYPE_SWIM) | (1 << TYPE_SWIMHR);
+    return q;
+}
 
-    //    if (l == r) return lhs.set < rhs.set;
-    return l < r;
+bool WorkoutQuery::matches(const Workout &w) const
+{
+    if (types && (w.type < 0 || w.type >= 31 || !(types & (1 << w.type))))
+        return false;
+    if (pool && w.pool != pool)
+        return false;
+    if ((w.sync & syncMask) != sync)
+        return false;
+    return distance <= 0 || coversDistance(w, distance);
 }
 
-void DataStore::remove(int id)
+void WorkoutView::const_iterator::skip()
 {
-    workouts.erase(workouts.begin()+id);
-    changed=true;
+    while (pos < view->last && !view->query.matches((*view->rows)[pos]))
+        ++pos;
 }
 
-void DataStore::removeSet(int wid, int sid)
+quint64 DataStore::fingerprint(const Workout &workout)
 {
-    std::vector<Set>& s = workouts[wid].sets;
-    s.erase(s.begin()+sid);
-    changed=true;
+    if (workout.sets.empty())
+        return 0;
+
+    Fnv fnv;
+    fnv.add(workout.type);
+    fnv.add(workout.pool);
+    fnv.add(workout.unit);
+
+    std::vector<Set>::const_iterator i;
+    for (i = workout.sets.begin(); i != workout.sets.end(); ++i)
+    {
+        fnv.add(i->duration);
+        fnv.add(i->lens);
+        fnv.add(i->strk);
+    }
+
+    // only the lengths of its sets, the table can hold others
+    const LengthTable lengths = workout.table.decoded();
+    for (i = workout.sets.begin(); i != workout.sets.end(); ++i)
+    {
+        for (int l = i->first; l < i->first + i->count; ++l)
+        {
+            fnv.add(lengths.time(l));
+            fnv.add(lengths.strokes(l));
+        }
+    }
+    // 0 is kept for no sets
+    return fnv.h ? fnv.h : 1;
 }
 
-// Remove all exercises at date
-void DataStore::remove( QDateTime dt )
+// The same hash as the workout they import as, read in place
+quint64 DataStore::fingerprint(const ExerciseSet *begin, const ExerciseSet *end)
 {
-    std::vector<Workout>::iterator i;
-    for (i=workouts.begin(); i != workouts.end(); ++i)
+    if (begin == end)
+        return 0;
+
+    Fnv fnv;
+    fnv.add(workoutTypes().code(begin->type));
+    fnv.add(begin->pool);
+    fnv.add(poolUnits().code(begin->unit));
+
+    const ExerciseSet *i;
+    for (i = begin; i != end; ++i)
+    {
+        fnv.add(i->duration);
+        fnv.add(i->lens);
+        fnv.add(i->strk);
+    }
+
+    // as packLengths() stores them
+    for (i = begin; i != end; ++i)
     {
-        if (QDateTime(i->date,i->time) == dt)
+        for (size_t l = 0; l < i->len_time.size(); ++l)
         {
-            changed=true;
-            workouts.erase(i);
+            fnv.add(qRound(i->len_time[l] * 1000));
+            fnv.add((quint16)(l < i->len_strokes.size() ? i->len_strokes[l] : 0));
         }
     }
+    return fnv.h ? fnv.h : 1;
 }
 
-int DataStore::add(const std::vector<ExerciseSet> &sets)
+bool DataStore::nearStart(qint64 a, qint64 b)
 {
-    sorted=false;
-    changed=true;
-    setsToWorkouts( sets,  workouts);
-    return -1;
+    if (a == NO_START || b == NO_START)
+        return a == b;
+    return qAbs(a - b) <= 24*60*60;
 }
 
-const std::vector<Workout>& DataStore::Workouts() const
+DataStore::Match DataStore::isImported(qint64 start, quint64 print, bool lengths)
 {
-    if (!sorted && workouts.size())
+    if (findExercise(startDateTime(start)) >= 0)
+        return STORED;
+    if (!print)
+        return NOT_STORED;
+
+    // built on first use, loads don't pay for decoding every length
+    if (!printed)
+    {
+        prints.clear();
+        std::vector<Workout>::const_iterator i;
+        for (i = Workouts().begin(); i != Workouts().end(); ++i)
+            prints.insert(fingerprint(*i), i->start);
+        printed = true;
+    }
+
+    // sets alone can repeat, a plan swum again the next day
+    QMultiHash<quint64, qint64>::const_iterator i;
+    for (i = prints.constFind(print); i != prints.constEnd() && i.key() == print; ++i)
     {
-        std::sort(workouts.begin(), workouts.end(), sortfn);
-        sorted=true;
+        if (nearStart(start, i.value()))
+            return lengths ? STORED : SIMILAR;
     }
-    return workouts;
+    return NOT_STORED;
+}
+
+void DataStore::track(const Workout &workout)
+{
+    aggregates.add(workout);
+    if (printed)
+        prints.insert(fingerprint(workout), workout.start);
+}
+
+void DataStore::untrack(const Workout &workout)
+{
+    aggregates.remove(workout);
+    if (!printed)
+        return;
+
+    // one of any copies at the same start
+    QMultiHash<quint64, qint64>::iterator i = prints.find(fingerprint(workout), workout.start);
+    if (i != prints.end())
+        prints.erase(i);
+}
+
+Aggregates::Buckets DataStore::totals(Aggregates::Period period, const QDate &from, const QDate &to) const
+{
+    return aggregates.range(period, from, to, Workouts());
+}
+
+const std::vector<Workout>& DataStore::Workouts() const
+{
+    return list->rows;
+}
+
+std::vector<Workout>& DataStore::workouts()
+{
+    list.detach();
+    return list->rows;
 }
 
 void DataStore::replaceSet( int wid, int sid, const Set & newSet )
 {
-    Workout & workout = workouts[wid];
+    const int row = findWorkout(wid);
+    if (row < 0)
+        return;
+
+    Workout & workout = workouts()[row];
+    untrack(workout);
     const Set oldSet = workout.sets[sid];
     workout.sets[sid] = newSet;
 
@@ -557,21 +2427,108 @@ void DataStore::replaceSet( int wid, int sid, const Set & newSet )
 
     // should we update max_eff, avg_eff, min_eff and cal as well?
 
-    changed = true;
+    track(workout);
+    touch(workout.start);
+    log(Journal::REPLACE, wid, &workout);
+    emit setModified(row, sid);
 }
 
 void DataStore::replaceWorkout( int wid, const Workout& wrk)
 {
-    workouts[wid] = wrk;
-    //Workout &workout = workouts[wid];
-    changed = true;
+    // moved to a year still on disk
+    loadFrom(startDate(wrk.start));
+
+    int row = findWorkout(wid);
+    if (row < 0)
+        return;
+
+    touch(Workouts()[row].start);
+    touch(wrk.start);
+    untrack(Workouts()[row]);
+
+    const int from = row;
+    const bool moved = wrk.start != Workouts()[row].start;
+    if (moved)
+    {
+        // start time changed, move it to its new place
+        workouts().erase(workouts().begin() + row);
+        row = std::upper_bound(workouts().begin(), workouts().end(), wrk.start, lessStart) - workouts().begin();
+        workouts().insert(workouts().begin() + row, wrk);
+        indexed=false;
+    }
+    else
+    {
+        workouts()[row] = wrk;
+    }
+
+    Workout &workout = workouts()[row];
+    workout.id = wid;
+    track(workout);
+    log(Journal::REPLACE, wid, &workout);
+
+    if (moved)
+    {
+        emit workoutRemoved(from);
+        emit workoutInserted(row);
+    }
+    else
+        emit workoutModified(row);
+}
+
+void DataStore::addSync( int wid, int flags )
+{
+    const int row = findWorkout(wid);
+    if (row < 0 || (Workouts()[row].sync & flags) == flags)
+        return;
+
+    Workout &workout = workouts()[row];
+    workout.sync |= flags;
+    touch(workout.start);
+    log(Journal::REPLACE, wid, &workout);
+    emit syncChanged(row);
+}
+
+int DataStore::setSync( const WorkoutQuery &query, int flags )
+{
+    // rows first, flagging copies a list a background save shares
+    std::vector<int> rows;
+    const WorkoutView view = this->query(query);
+    WorkoutView::const_iterator i;
+    for (i = view.begin(); i != view.end(); ++i)
+    {
+        if ((i->sync & flags) != flags)
+            rows.push_back(i.row());
+    }
+    if (rows.empty())
+        return 0;
+
+    std::vector<Workout> &w = workouts();
+    std::vector<int> ids;
+    std::vector<int>::const_iterator r;
+    for (r = rows.begin(); r != rows.end(); ++r)
+    {
+        w[*r].sync |= flags;
+        touch(w[*r].start);
+        ids.push_back(w[*r].id);
+    }
+    changed=true;
+    ++edits;
+
+    // One journal entry for every row, the years are written as usual
+    if (!journal->append(Journal::SYNC, flags, ids))
+        rewrite=true;
+    saveIfDue();
+
+    for (r = rows.begin(); r != rows.end(); ++r)
+        emit syncChanged(*r);
+    return rows.size();
 }
 
 bool fit_write(const QString& file, const Workout& workout, bool overwrite=false);
 
 bool DataStore::exportWorkout(const QString &dirname, QString &filename, const Workout& workout) const
 {
-    QString name = QDateTime(workout.date,workout.time).toString("yyyyMMddHHmmss");
+    QString name = startDateTime(workout.start).toString("yyyyMMddHHmmss");
     QString file = QString("%1/%2.fit")
             .arg(dirname)
             .arg(name);
@@ -20,24 +20,96 @@
 #define DATASTORE_H
 
 #include <vector>
+#include <QFuture>
+#include <QHash>
+#include <QMap>
+#include <QObject>
+#include <QSet>
+#include <QSharedData>
+#include "aggregates.h"
 #include "exerciseset.h"
+#include "vocabulary.h"
+
+class Journal;
+class SqlStore;
+
+// Read poolmate csv file, threads 0 uses one per core
+bool ReadCSV( const std::string & name, std::vector<ExerciseSet>& dst, int threads );
 
 struct Set
 {
+    Set() : duration(-1), rest(-1), first(0), count(0) {}
+
     int set;
-    QTime duration;
+    int duration; // ms
     int lens;
     int strk;
     int dist;
     int speed;
     int effic;
     int rate;
-    QTime rest;
+    int rest; // ms, -1 if unknown
     double num; // dummy value to keep files in sync
 
-    std::vector<double> times;
-    std::vector<int> strokes;
-    std::vector<QString> styles;
+    // lengths of this set in the workout's length table
+    int first;
+    int count;
+};
+
+// Per length data packed in parallel arrays. One block holds the
+// lengths of every workout read by a load so they are freed together.
+struct LengthBlock : public QSharedData
+{
+    void reserve(size_t n);
+    void append(qint32 msecs, quint16 strokes, quint16 style);
+
+    std::vector<qint32> times; // ms
+    std::vector<quint16> strokes;
+    std::vector<quint16> styles; // strokeStyles() code, 0 is no style
+};
+
+// Lengths left in the data file until first used, see ReadStore
+class LengthSource : public QSharedData
+{
+public:
+    virtual ~LengthSource() {}
+
+    // Lengths of the nth workout read
+    virtual QExplicitlySharedDataPointer<LengthBlock> lengths(int n) = 0;
+};
+
+// Lengths of all sets of a workout, a range of a shared block or
+// still undecoded in a source. Changes copy the range out first.
+class LengthTable
+{
+public:
+    LengthTable() : first(0), count(0) {}
+    LengthTable(LengthBlock *_block, int _first, int _count)
+        : block(_block), first(_first), count(_count) {}
+    LengthTable(LengthSource *_source, int n, int _count)
+        : source(_source), first(n), count(_count) {}
+
+    int size() const { return count; }
+    bool isDecoded() const { return block || !source; }
+
+    // An undecoded table is looked up on each call, see decoded()
+    qint32 time( int l ) const { return block ? block->times[first + l] : decoded().time(l); }
+    int strokes( int l ) const { return block ? block->strokes[first + l] : decoded().strokes(l); }
+    int style( int l ) const { return block ? block->styles[first + l] : decoded().style(l); }
+
+    // Table with lengths in memory, use for loops over an undecoded table
+    LengthTable decoded() const;
+
+    void insert( int l, qint32 msecs, quint16 strokes, quint16 style );
+    void remove( int l, int n );
+
+private:
+    void detach();
+
+    QExplicitlySharedDataPointer<LengthBlock> block;
+    QExplicitlySharedDataPointer<LengthSource> source;
+    int first; // workout number in source while undecoded
+    int count;
 };
 
 enum syncstatus
@@ -49,17 +121,18 @@ enum syncstatus
 
 struct Workout
 {
-    int id;
+    Workout() : id(0), start(NO_START), totalduration(-1), rest(-1) {}
+
+    int id; // unique, kept in the data file
 
-    mutable uint8_t sync; //syncstatus bitfield
+    uint8_t sync; //syncstatus bitfield, see DataStore::addSync
     int user;
-    QDate date;
-    QTime time;
-    QString type;
+    qint64 start; // seconds since 1/1/1970, see exerciseset.h
+    int type; // workoutTypes() code
     int pool;
-    QString unit;
-    QTime totalduration;
-    QTime rest;
+    int unit; // poolUnits() code
+    int totalduration; // ms
+    int rest; // ms, -1 if unknown
 
     int max_eff;
     int avg_eff;
@@ -70,36 +143,213 @@ struct Workout
     int totaldistance;
 
     std::vector<Set> sets;
+    LengthTable table;
+
+    double lengthTime( const Set &set, int l ) const { return table.time(set.first + l) / 1000.0; }
+    int lengthMsecs( const Set &set, int l ) const { return table.time(set.first + l); }
+    int lengthStrokes( const Set &set, int l ) const { return table.strokes(set.first + l); }
+    int lengthStyle( const Set &set, int l ) const { return table.style(set.first + l); }
+
+    // Append a length to the end of set s, later sets move up
+    void addLength( int s, int msecs, int strokes, int style );
+    // Drop set s and its lengths, later sets move down
+    void removeSet( int s );
 };
 
+// Read poolmate csv file straight into workouts
+bool ReadCSV( const std::string & name, std::vector<Workout>& dst, int threads );
+
+// Milliseconds since julian day 0, matches journal entries by start time
+qint64 workoutKey(const QDate &date, const QTime &time);
 
-class DataStore
+// Workout list shared with background saves, copied on change
+struct WorkoutList : public QSharedData
+{
+    std::vector<Workout> rows;
+};
+
+class WorkoutView;
+struct WorkoutQuery;
+
+// The workouts as they were when taken. Safe to read on any thread
+// while the store carries on changing, changes copy the list first
+// rather than touch one a snapshot holds.
+class WorkoutSnapshot
 {
+public:
+    WorkoutSnapshot() : list(new WorkoutList) {}
+
+    const std::vector<Workout>& workouts() const { return list->rows; }
+    size_t size() const { return list->rows.size(); }
+    const Workout& operator[]( size_t row ) const { return list->rows[row]; }
+
+    // As DataStore::query(), valid while this snapshot is kept
+    WorkoutView query( const WorkoutQuery &query ) const;
+
+private:
+    friend class DataStore;
+    explicit WorkoutSnapshot( WorkoutList *_list ) : list(_list) {}
+
+    QExplicitlySharedDataPointer<WorkoutList> list;
+};
+
+// Which workouts query() matches, all of them by default
+struct WorkoutQuery
+{
+    WorkoutQuery();
+
+    // Only swims, TYPE_SWIM and TYPE_SWIMHR
+    static WorkoutQuery swims();
+
+    bool matches( const Workout &workout ) const;
+
+    qint64 from; // start in [from, to)
+    qint64 to;
+    int types; // bit 1 << workoutTypes() code for each wanted, 0 for any
+    int pool; // pool length, 0 for any
+    int distance; // with a set at least this long, 0 for any
+    int syncMask; // syncstatus flags looked at
+    int sync; // and the values they must have
+};
+
+// Rows matching a query, walked in place in start order. Only valid
+// until the store next changes.
+class WorkoutView
+{
+public:
+    class const_iterator
+    {
+    public:
+        const_iterator() : view(0), pos(0) {}
+
+        const Workout& operator*() const { return (*view->rows)[pos]; }
+        const Workout* operator->() const { return &(*view->rows)[pos]; }
+        const_iterator& operator++() { ++pos; skip(); return *this; }
+        bool operator==( const const_iterator &o ) const { return pos == o.pos; }
+        bool operator!=( const const_iterator &o ) const { return pos != o.pos; }
+
+        // Row in Workouts()
+        int row() const { return pos; }
+
+    private:
+        friend class WorkoutView;
+        const_iterator( const WorkoutView *_view, int _pos ) : view(_view), pos(_pos) { skip(); }
+        void skip();
+
+        const WorkoutView *view;
+        int pos;
+    };
+
+    const_iterator begin() const { return const_iterator(this, first); }
+    const_iterator end() const { return const_iterator(this, last); }
+    bool empty() const { return begin() == end(); }
+
+private:
+    friend class DataStore;
+    friend class WorkoutSnapshot;
+    WorkoutView( const std::vector<Workout> &_rows, const WorkoutQuery &_query );
+
+    const std::vector<Workout> *rows;
+    int first; // rows in the date range
+    int last;
+    WorkoutQuery query;
+};
+
+class DataStore : public QObject
+{
+Q_OBJECT
 public:
     DataStore();
+    ~DataStore();
 
     // Locate first exercise id with matching datetime.
+    // Ids are rows of the sorted Workouts() list, found by binary search.
     int findExercise( QDateTime dt);
     int findExercise( QDate dt);
 
-    // Insert exercise into datastore, return id
+    // Row of workout id in Workouts(), -1 if not found
+    int findWorkout( int id ) const;
+    const Workout* getWorkout( int id ) const;
+
+    // Insert exercise into datastore, return id of last workout added
     int add( const std::vector<ExerciseSet>& set) ;
 
     // Remove exercise with id
     void remove(int id);
     void removeSet( int wid, int sid );
 
-    // Replace set in workout
+    // Replace set in workout, workouts are addressed by id
     void replaceSet( int wid, int sid, const Set & newSet );
     void replaceWorkout( int wid, const Workout& workout);
 
+    // Add syncstatus flags to workout id
+    void addSync( int wid, int flags );
+    // Add them to every workout query matches, in one journal entry
+    // rather than one each. Returns how many changed.
+    int setSync( const WorkoutQuery &query, int flags );
+
     // Remove all exercises at date
     void remove( QDateTime dt );
 
+    // Remove every workout query matches in one pass, such as all of a
+    // type or a date range. Returns how many went.
+    int remove( const WorkoutQuery &query );
+
+    // Workouts matching query, found from the start order
+    WorkoutView query( const WorkoutQuery &query ) const;
+
+    // Rows of swims starting in [from, to), in order. With distance
+    // only those with a set at least that long, see query().
+    std::vector<int> findSwims( qint64 from, qint64 to, int distance = 0 ) const;
+
+    // How a session from a file or watch matches what is stored
+    enum Match
+    {
+        NOT_STORED,
+        SIMILAR,    // same sets near its start, no lengths to be sure
+        STORED      // at its start, or a copy with the same lengths
+    };
+
+    // Content of a workout or a session of sets from a file or watch,
+    // without its start so copies with the clock off match. 0 if no sets.
+    static quint64 fingerprint( const Workout &workout );
+    static quint64 fingerprint( const ExerciseSet *begin, const ExerciseSet *end );
+
+    // Starts close enough for a copy, a clock or time zone a day out
+    static bool nearStart( qint64 a, qint64 b );
+
+    // Whether a session at start is stored, or a copy of it near start
+    Match isImported( qint64 start, quint64 fingerprint, bool lengths );
+
+    // Totals of the swims in each period starting in [from, to), an
+    // invalid to runs to the last
+    Aggregates::Buckets totals( Aggregates::Period period, const QDate &from, const QDate &to ) const;
+
+    // Older years stay on disk until asked for. Load the years from
+    // date on, an invalid date loads everything. true if workouts were
+    // added, rows already fetched are then out of date.
+    bool loadFrom( const QDate &date );
+    bool loadAll() { return loadFrom(QDate()); }
+
     //move?
     void setFile(const QString &_filename) { filename=_filename;}
     void setBackup(bool _backup) { backup = _backup; }
+    void setBackupKeep(int _keep) { backupKeep = _keep; }
+    void setCsvExport(bool _export) { csvExport = _export; }
+    void setLoadThreads(int _threads) { loadThreads = _threads; }
+    void setLazyLoad(bool _lazy) { lazyLoad = _lazy; }
+    void setDatabase(bool _database);
+    // Autosave after this many changes, 0 for none
+    void setAutosaveEdits(int _edits) { autosaveEdits = _edits; }
     const QString& getFile() { return filename;}
+    QString storeFile() const;
+    // Data file for one year, 0 for workouts without a date
+    QString shardFile(int year) const;
+    QString journalFile() const;
+    QString databaseFile() const;
+
+    // Write all workouts in poolmate csv format
+    bool exportCSV(const QString &file);
 
     bool exportWorkout(const QString &directory, QString &filename, const Workout &workout) const;
 
@@ -108,21 +358,111 @@ public:
 
     //
     bool load();
+    // Why load() could not carry on the journal, empty if it could
+    const QString& loadError() const { return error; }
     bool save();
-    void setChanged() { changed=true;}
+    void setChanged() { changed=true; rewrite=true; ++edits;}
+
+    // Start writing unsaved changes on a worker thread
+    void autosave();
     const std::vector<Workout>& Workouts() const;
 
+    // Workouts() as now, for worker threads to read while it changes
+    WorkoutSnapshot snapshot() const { return WorkoutSnapshot(list.data()); }
+
+signals:
+    // Sent once each change is made, rows are positions in Workouts()
+    void workoutInserted(int row);
+    void workoutRemoved(int row); // where it was
+    void workoutModified(int row);
+    void setModified(int row, int set); // workout totals with it
+    void syncChanged(int row);
+    // Too many rows changed to list, such as older years loaded
+    void workoutsReset();
+
 private:
+    // Record a change in the journal
+    void log(int op, qint64 key, const Workout *workout = 0);
+    // log() in two halves, for changes made in several steps
+    void record(int op, qint64 key, const Workout *workout);
+    void saveIfDue();
+    bool usingDatabase() const;
+    bool csvOutdated() const;
+    int backups() const { return backup ? backupKeep : 0; }
+
+    // Rows to change, copied first if a background save shares them
+    std::vector<Workout>& workouts();
+    void replay(const QMap<int, quint64> &sequences, quint64 base, bool &older);
+    bool assignIds();
+    std::vector<int> take( const WorkoutQuery &query, int &row );
+    void sendRemoved( size_t count, int row );
+    // Keep totals and fingerprints in step with a row added or removed
+    void track(const Workout &workout);
+    void untrack(const Workout &workout);
+
+    // Append the data files for years [from, to)
+    bool readShards(int from, int to, std::vector<Workout>& dst, QMap<int, quint64> *sequences = 0);
+    bool readDatabase(int from, int to, std::vector<Workout>& dst);
+    // Year of start needs writing
+    void touch(qint64 start) { dirty.insert(shardYear(start)); }
+    static int shardYear(qint64 start);
+    // Years to write now, every one in memory when rewriting
+    QList<int> takeDirty();
+    // Lengths still read from the years' files, before those are replaced
+    void decodeYears(const QList<int> &years);
+
+    // Fold journal into the data file
+    bool compact(bool wait);
+    void saveInBackground(bool store);
+    void finishCompaction();
+
     //assign id to each workout
     int counter;
 
+    // workout id to row, rebuilt after rows move
+    mutable QHash<int, int> index;
+    mutable bool indexed;
+
     // Exercise sets must be sorted by time
-    mutable std::vector<Workout> workouts;
+    QExplicitlySharedDataPointer<WorkoutList> list;
+
+    // kept in step with every change to the rows
+    mutable Aggregates aggregates;
+    QMultiHash<quint64, qint64> prints; // starts by fingerprint, see isImported()
+    bool printed;
 
     bool changed;
-    mutable bool sorted;
+    QString error;
     QString filename;
     bool backup;
+    int backupKeep; // newest backups kept
+    bool csvExport;
+    int loadThreads;
+    bool lazyLoad; // lengths decoded from the data file on first use
+
+    // One data file per year, see shardFile()
+    QMap<int, quint64> shards; // years on disk, sequence once read
+    int storedId; // highest id in any of them
+    int oldest; // first year in memory, INT_MIN when all are
+    QSet<int> dirty; // years changed since written
+
+    Journal *journal;
+    bool rewrite; // every year in memory needs writing
+    bool refill; // database behind the data files, written in full
+    bool refilling; // by the background save
+    QFuture<bool> compaction;
+    bool pending; // background save not yet finished with
+    quint64 compacted; // journal covered by it, 0 if no data file
+    quint64 exporting; // edits in its csv copy, 0 if none
+
+    // counts changes, for autosave and the csv copy
+    quint64 edits;
+    quint64 autosaved;
+    quint64 exported;
+    int autosaveEdits;
+
+    // read in place of the data files when set, see load()
+    SqlStore *database;
 };
 
 #endif
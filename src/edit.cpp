@@ -24,10 +24,10 @@
 
 namespace
 {
-void extractSetData(const Set & set, int & lengths, QTime & duration, double & average)
+void extractSetData(const Workout & wrk, const Set & set, int & lengths, QTime & duration, double & average)
 {
-    lengths = set.times.size();
-    duration = getActualSwimTime(set);
+    lengths = set.count;
+    duration = getActualSwimTime(wrk, set);
 
     const double actualTime = duration.msecsSinceStartOfDay() / 1000.0;
 
@@ -55,29 +55,29 @@ void fillSet(QTableWidget * grid, int row, const Set & set, const Workout & orig
     double average;
     QTime duration;
 
-    extractSetData(set, lengths, duration, average);
+    extractSetData(original, set, lengths, duration, average);
     const double actualTime = duration.msecsSinceStartOfDay() / 1000.0;
 
     if (average < 1) //increase to a sensible lower value
     {
         // Pick an average from workout data
-        double real = original.totalduration.msecsSinceStartOfDay()
-                - original.rest.msecsSinceStartOfDay();
+        double real = qMax(original.totalduration, 0)
+                - qMax(original.rest, 0);
         average = real / original.lengths / 1000;
     }
 
     actual = QTime(0,0).addMSecs(actualTime * 1000);
 
-    const double recordedTime = set.duration.msecsSinceStartOfDay() / 1000;
+    const double recordedTime = qMax(set.duration, 0) / 1000;
     double gap = recordedTime - actualTime;
 
     int col=0;
     grid->setItem(row, col++, createTableWidgetItem(QVariant(row + 1)));
     grid->setItem(row, col++, createTableWidgetItem(QVariant(lengths)));
 
-    grid->setItem(row, col++, createTableWidgetItem(QVariant(set.rest.toString())));
+    grid->setItem(row, col++, createTableWidgetItem(QVariant(msecsToTime(set.rest).toString())));
 
-    grid->setItem(row, col++, createTableWidgetItem(QVariant(set.duration.toString())));
+    grid->setItem(row, col++, createTableWidgetItem(QVariant(msecsToTime(set.duration).toString())));
     grid->setItem(row, col++, createTableWidgetItem(QVariant(actual.toString())));
 
     if (gap >= 1)
@@ -133,7 +133,7 @@ void Edit::populate(const Workout& _wrk)
 }
 
 Edit::Edit(QWidget *parent, const Workout & _wrk) :
-    QDialog(parent), original(_wrk), deleted(false), changed(false)
+    QDialog(parent), original(_wrk), currentSet(-1), newLengths(0), newTime(0), deleted(false), changed(false)
 {
     setupUi(this);
 
@@ -178,7 +178,7 @@ void Edit::calculate()
     if (currentSet>=0)
     {
         setMod = setOrig;
-
+        newLengths = 0;
 
         const int extraLengths = newLengthsSpin->value();
 
@@ -187,7 +187,7 @@ void Edit::calculate()
             int setLens;
             QTime duration;
             double setAvg;
-            extractSetData(setOrig, setLens, duration, setAvg);
+            extractSetData(modified, setOrig, setLens, duration, setAvg);
 
 
             const double gapTime = gapTimeUsedSpin->value();
@@ -196,27 +196,17 @@ void Edit::calculate()
 
             setMod.strk = strokesEdit->value();
 
-            for (int i = 0; i < extraLengths; ++i)
-            {
-                // add a lengths keeping the rest syncronised
-                ++setMod.lens;
-
-                setMod.times.push_back(average);
-                setMod.strokes.push_back(setMod.strk);
-            }
-
-            if (!setMod.styles.empty())
-            {
-                // add empty string at the end
-                setMod.styles.resize(setMod.lens);
-            }
+            // lengths are added to the workout on adjust
+            setMod.lens += extraLengths;
+            newLengths = extraLengths;
+            newTime = average;
 
             //Add pool length edit too
             setMod.dist = modified.pool * setMod.lens;
 
             //adjust duration
-            setMod.duration = duration.addSecs( gapTime );
-            int setsecs = setMod.duration.msecsSinceStartOfDay() / 1000;
+            setMod.duration = toMsecs(duration.addSecs( gapTime ));
+            int setsecs = qMax(setMod.duration, 0) / 1000;
 
             setMod.speed = 100 * setsecs / setMod.dist;
             setMod.effic = ((25 * setsecs / setMod.lens) + (25 * setMod.strk)) / modified.pool;
@@ -255,19 +245,20 @@ void Edit::on_deleteButton_clicked()
                                     QMessageBox::Yes|QMessageBox::No);
     if (ret == QMessageBox::Yes)
     {
-        std::vector<Set> sets;
-        for (int i = 0; i < setsGrid->rowCount(); ++i)
+        // last first so rows still match sets
+        for (int i = setsGrid->rowCount() - 1; i >= 0; --i)
         {
             QTableWidgetItem* it = setsGrid->item(i,0);
-            if (!it->isSelected())
+            if (it->isSelected())
             {
-                sets.push_back(modified.sets[i]);
+                modified.removeSet(i);
             }
         }
-        modified.sets = sets;
         changed=true;
 
+        // sets after the deleted ones have moved
         populate(modified);
+        on_setsGrid_currentCellChanged(setsGrid->currentRow(), 0, -1, 0);
         calculate();
 
         // recalc workout summary
@@ -283,8 +274,17 @@ void Edit::on_adjustButton_clicked()
     {
         changed = true;
         modified.sets[currentSet] = setMod;
+
+        for (int i = 0; i < newLengths; ++i)
+        {
+            modified.addLength(currentSet, qRound(newTime * 1000), setMod.strk, 0);
+        }
     }
     populate(modified);
+
+    // a further adjust starts from the set as it is now
+    if (currentSet >= 0)
+        on_setsGrid_currentCellChanged(currentSet, 0, currentSet, 0);
 }
 
 //
@@ -303,18 +303,18 @@ void Edit::on_setsGrid_currentCellChanged(int currentRow, int /*currentColumn*/,
         QTime duration;
         double average;
 
-        extractSetData(setOrig, lengths, duration, average);
+        extractSetData(modified, setOrig, lengths, duration, average);
 
         if (average < 1) //increase to a sensible lower value
         {
             // Pick an average from *original* workout data
-            double real = original.totalduration.msecsSinceStartOfDay()
-                    - original.rest.msecsSinceStartOfDay();
+            double real = qMax(original.totalduration, 0)
+                    - qMax(original.rest, 0);
             average = real / original.lengths / 1000;
         }
 
         const double actualTime = duration.msecsSinceStartOfDay() / 1000.0;
-        const double recordedTime = setOrig.duration.msecsSinceStartOfDay() / 1000;
+        const double recordedTime = qMax(setOrig.duration, 0) / 1000;
         gap = recordedTime - actualTime;
 
         gapTimeUsedSpin->setMaximum(gap);
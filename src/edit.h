@@ -61,6 +61,8 @@ private:
     int currentSet;
     Set setOrig;
     Set setMod;
+    int newLengths; // added to setMod on adjust
+    double newTime;
 
     double gap;
 
@@ -18,32 +18,83 @@
 #ifndef EXERCISESET_H
 #define EXERCISESET_H
 
-#include <QDate>
+#include <QDateTime>
 #include <stdint.h>
+#include <limits>
+
+// Start times are held as seconds since 1/1/1970 on the watch's local
+// clock (no timezone applied), durations as milliseconds with -1 for
+// unset. QDate/QTime are only built for display and file formats.
+const qint64 NO_START = std::numeric_limits<qint64>::min();
+const qint64 epoch_day = 2440588; // julian day of 1/1/1970
+
+inline qint64 toStart(const QDate &date, const QTime &time)
+{
+    if (!date.isValid())
+        return NO_START;
+    return (date.toJulianDay() - epoch_day) * 86400 +
+            (time.isValid() ? time.msecsSinceStartOfDay() / 1000 : 0);
+}
+
+inline qint64 toStart(const QDateTime &dt)
+{
+    return toStart(dt.date(), dt.time());
+}
+
+inline qint64 startDay(qint64 start)
+{
+    return start >= 0 ? start / 86400 : -((-start + 86399) / 86400);
+}
+
+inline QDate startDate(qint64 start)
+{
+    return start == NO_START ? QDate() : QDate::fromJulianDay(epoch_day + startDay(start));
+}
+
+inline QTime startTime(qint64 start)
+{
+    return start == NO_START ? QTime() : QTime(0, 0).addSecs(start - startDay(start) * 86400);
+}
+
+inline QDateTime startDateTime(qint64 start)
+{
+    return QDateTime(startDate(start), startTime(start));
+}
+
+inline int toMsecs(const QTime &t)
+{
+    return t.isValid() ? t.msecsSinceStartOfDay() : -1;
+}
+
+inline QTime msecsToTime(int msecs)
+{
+    return msecs < 0 ? QTime() : QTime::fromMSecsSinceStartOfDay(msecs);
+}
 
 // File format for CSV storage
 struct ExerciseSet
 {
+    ExerciseSet() : start(NO_START), totalduration(-1), duration(-1), rest(-1) {}
+
     int user;                   /**< user number 1..n */
-    QDate date;                 /**< date of workout */
-    QTime time;                 /**< time of workout begining */
+    qint64 start;               /**< start of workout, seconds since 1/1/1970 local time */
     QString type;               /**< type of watch Swim, SwimHR */
     int pool;                   /**< Pool length */
     QString unit;               /**< Pool length unit m,? */
-    QTime totalduration;        /**< Total duration of workout */
+    int totalduration;          /**< Total duration of workout (ms) */
     int cal;                    /**< calories (Kcal) used during this workout */
     int lengths;                /**< number of length in this workout */
     int totaldistance;          /**< total distance of this workout (in units) */
 
     int set;                    /**< Set/lap number 1..n */
-    QTime duration;             /**< duration of this set/lap */
+    int duration;               /**< duration of this set/lap (ms) */
     int lens;                   /**< number of length for this set/lap */
     int strk;                   /**< average number of strokes per length for this set/lap */
     int dist;                   /**< distance for this set/lap == e.lens*e.pool  */
     int speed;                  /**< time to cover 100m */
     int effic;                  /**< swolf(ish) for this set/lap. Poolmate uses number of "stroke cycles" i.e. one arm. Garmin uses "stroke count" i.e. both arms */
     int rate;                   /**< strokes per minute */
-    QTime rest;                 /**< rest time for this set/lap */
+    int rest;                   /**< rest time for this set/lap (ms), -1 if unknown */
     double num;                 /**< dummy value to keep file import/output compatible */
 
     uint8_t sync;               /**< sync status */
@@ -34,7 +34,6 @@ Export::Export(QWidget *parent) :
     ui->garminChk->setEnabled(!garminUser.isEmpty());
 
     garminCookies = false;
-    changed = false;
 
     ui->progressBar->setValue(0);
     ui->progressBar->setMinimum(0);
@@ -101,92 +100,89 @@ void Export::on_shareButton_clicked()
         return;
     }
 
-    changed = false;
+    ds->loadAll();
 
-    ui->progressBar->setMaximum(ds->Workouts().size());
+    // just those with lengths
+    WorkoutQuery wanted;
+    wanted.types = 1 << TYPE_SWIMHR;
 
-    std::vector<Workout>::const_iterator i;
-    int count=1;
-    for ( i = ds->Workouts().begin(); i != ds->Workouts().end(); ++i, ++count)
+    // Dated workouts are only flagged, all in one go, the rest exported
+    if (ui->todayButton->isChecked())
     {
-        ui->progressBar->setValue(count);
+        WorkoutQuery dated;
+        dated.from = NO_START + 1;
+        if (ui->flagBox->isChecked())
+            ds->setSync(dated, SYNC_FIT|SYNC_GARMIN|SYNC_STRAVA);
+        wanted.to = dated.from;
+    }
+
+    // rows first, flagging workouts changes the store under a view
+    std::vector<int> rows;
+    const WorkoutView view = ds->query(wanted);
+    WorkoutView::const_iterator i;
+    for (i = view.begin(); i != view.end(); ++i)
+        rows.push_back(i.row());
+
+    ui->progressBar->setMaximum(rows.size());
+
+    for (size_t r = 0; r < rows.size(); ++r)
+    {
+        ui->progressBar->setValue(r + 1);
 
-        if (ui->todayButton->isChecked() &&
-                i->date != QDate())
+        // a copy, flagging a workout can copy the list it is in
+        const Workout workout = ds->Workouts()[rows[r]];
+
+        bool fit = false;
+        QString filename;
+
+        if (ui->FITChk->isChecked() ||
+                ui->stravaChk->isChecked() ||
+                ui->garminChk->isChecked() )  // All three require a fit file to exist
         {
-            if (ui->flagBox->isChecked())
+            filename.clear();
+            if (ds->exportWorkout(dirname, filename, workout)) //Create a  FIT file
             {
-                i->sync |= SYNC_FIT|SYNC_GARMIN|SYNC_STRAVA;
-                changed=true;
+                ds->addSync(workout.id, SYNC_FIT);
+                fit=true; // we have or made a fit file
             }
-            continue;
         }
 
-        if ( i->type=="SwimHR" ) //Only interested in exporting data with lengths
+        if (fit && !filename.isEmpty()) // We have a fit file so upload
         {
-            bool fit = false;
-            QString filename;
-
-            if (ui->FITChk->isChecked() ||
-                    ui->stravaChk->isChecked() ||
-                    ui->garminChk->isChecked() )  // All three require a fit file to exist
+            if (ui->stravaChk->isChecked())
             {
-                filename.clear();
-                if (ds->exportWorkout(dirname, filename, *i)) //Create a  FIT file
+                if (!(workout.sync & SYNC_STRAVA))
                 {
-                    if (!(i->sync & SYNC_FIT))
+                    if (uploadToStrava(filename))
+                    {
+                        ds->addSync(workout.id, SYNC_STRAVA);
+                    }
+                    else
                     {
-                        i->sync |= SYNC_FIT;
-                        changed=true;
+                        QMessageBox::information(this,tr("Error"),tr("Problem uploading to Strava."));
+                        break;
                     }
-                    fit=true; // we have or made a fit file
                 }
             }
 
-            if (fit && !filename.isEmpty()) // We have a fit file so upload
+            if (ui->garminChk->isChecked())
             {
-                if (ui->stravaChk->isChecked())
+                if (!(workout.sync & SYNC_GARMIN))
                 {
-                    if (!(i->sync & SYNC_STRAVA))
+                    if (uploadToGarmin( filename ))
                     {
-                        if (uploadToStrava(filename))
-                        {
-                            i->sync |= SYNC_STRAVA;
-                            changed=true;
-                        }
-                        else
-                        {
-                            QMessageBox::information(this,tr("Error"),tr("Problem uploading to Strava."));
-                            break;
-                        }
+                        ds->addSync(workout.id, SYNC_GARMIN);
                     }
-                }
-
-                if (ui->garminChk->isChecked())
-                {
-                    if (!(i->sync & SYNC_GARMIN))
+                    else
                     {
-                        if (uploadToGarmin( filename ))
-                        {
-                            i->sync |= SYNC_GARMIN;
-                            changed=true;
-                        }
-                        else
-                        {
-                            QMessageBox::information(this,tr("Error"),tr("Problem uploading to Garmin."));
-                            break;
-                        }
-
+                        QMessageBox::information(this,tr("Error"),tr("Problem uploading to Garmin."));
+                        break;
                     }
+
                 }
             }
         }
     }
-
-    if (changed)
-    {
-        ds->setChanged();
-    }
 }
 
 bool Export::uploadToStrava(const QString& filename)
@@ -35,7 +35,6 @@ private slots:
 private:
     bool initializeGarminCookies();
 
-    bool changed;
     DataStore *ds;
     Ui::Export *ui;
 
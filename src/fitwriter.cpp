@@ -156,13 +156,13 @@ void write_record(QByteArray *array, const Workout& wrk, const Set& set, int dis
     write_int8(array, record_header);
 
     //timestamp (end of length)
-    write_int32(array, lenstart.toTime_t()-qbase_time.toTime_t() + set.times[l]);
+    write_int32(array, lenstart.toTime_t()-qbase_time.toTime_t() + wrk.lengthTime(set, l));
 
     //cumulative distance
     write_int32(array, dist*100);
 
     //speed
-    write_int16(array, wrk.pool *1000 / set.times[l]); //speed kp/h
+    write_int16(array, wrk.pool *1000 / wrk.lengthTime(set, l)); //speed kp/h
 }
 
 void write_length(QByteArray *array, const Workout& wrk, const Set& set, int first, int l,
@@ -206,24 +206,24 @@ void write_length(QByteArray *array, const Workout& wrk, const Set& set, int fir
     // Record ------
     write_int8(array, length_header);
 
-    write_int32(array, lenstart.toTime_t()-qbase_time.toTime_t() + set.times[l]);
+    write_int32(array, lenstart.toTime_t()-qbase_time.toTime_t() + wrk.lengthTime(set, l));
     write_int16(array, first + l);
 
     write_int32(array, lenstart.toTime_t()-qbase_time.toTime_t());
 
-    write_int32(array, set.times[l] * 1000); //elapsed
-    write_int32(array, set.times[l] * 1000); //timer
-    write_int16(array, set.strokes[l]);
+    write_int32(array, wrk.lengthMsecs(set, l)); //elapsed
+    write_int32(array, wrk.lengthMsecs(set, l)); //timer
+    write_int16(array, wrk.lengthStrokes(set, l));
 
     write_int8(array, 28); //length
     write_int8(array, 3); //marker
     write_int8(array, 1); //active
 
-    //TODO   QString styl = set.styles[i];
+    //TODO   QString styl = strokeStyles().name(wrk.lengthStyle(set, l));
     write_int8(array, 0); //freestyle
 
-    write_int16(array, wrk.pool *1000 / set.times[l]);     //speed kp/h
-    write_int8(array, 60 * set.strokes[l] /set.times[l]);  //cadence
+    write_int16(array, wrk.pool *1000 / wrk.lengthTime(set, l));     //speed kp/h
+    write_int8(array, 60 * wrk.lengthStrokes(set, l) / wrk.lengthTime(set, l));  //cadence
 }
 
 void write_rest(QByteArray *array, const Workout& /*wrk*/, const Set& set,int snum, int first,
@@ -232,12 +232,12 @@ void write_rest(QByteArray *array, const Workout& /*wrk*/, const Set& set,int sn
     // Record ------
     write_int8(array, length_header);
 
-    write_int32(array, lenstart.toTime_t()-qbase_time.toTime_t() + set.rest.msecsSinceStartOfDay()/1000);
+    write_int32(array, lenstart.toTime_t()-qbase_time.toTime_t() + qMax(set.rest, 0)/1000);
     write_int16(array, first); //index
     write_int32(array, lenstart.toTime_t()-qbase_time.toTime_t());
 
-    write_int32(array, set.rest.msecsSinceStartOfDay()); //elapsed
-    write_int32(array, set.rest.msecsSinceStartOfDay()); //timer
+    write_int32(array, qMax(set.rest, 0)); //elapsed
+    write_int32(array, qMax(set.rest, 0)); //timer
     write_int16(array, 0xffff); //strokes
     write_int8(array, 28);      //length
     write_int8(array, 1);       //stop
@@ -251,11 +251,11 @@ void write_rest(QByteArray *array, const Workout& /*wrk*/, const Set& set,int sn
     write_int8(array, lap_header);
 
     write_int16(array, snum); //index
-    write_int32(array, lenstart.toTime_t()-qbase_time.toTime_t() + set.rest.msecsSinceStartOfDay()/1000);
+    write_int32(array, lenstart.toTime_t()-qbase_time.toTime_t() + qMax(set.rest, 0)/1000);
     write_int32(array, lenstart.toTime_t()-qbase_time.toTime_t());
 
-    write_int32(array, set.rest.msecsSinceStartOfDay()); //elapsed
-    write_int32(array, set.rest.msecsSinceStartOfDay()); //timer
+    write_int32(array, qMax(set.rest, 0)); //elapsed
+    write_int32(array, qMax(set.rest, 0)); //timer
 
     write_int32(array, 0);
     write_int32(array, 0xffffffff); //strokes
@@ -282,14 +282,14 @@ void write_lens(QByteArray *array, const Workout& wrk, int snum, int lnum, const
     }
 
     int i;
-    for (i=0; i< set.lens; ++i)
+    for (i=0; i< set.count; ++i)
     {
         dist += wrk.pool;
 
         write_length(array, wrk, set, lnum, i, len_start);
         write_record(array, wrk, set, dist, i, len_start);
 
-        len_start=len_start.addMSecs(set.times[i]*1000);
+        len_start=len_start.addMSecs(wrk.lengthMsecs(set, i));
     }
 }
 
@@ -332,7 +332,7 @@ void write_laps(QByteArray *array, const Workout &workout )
     std::vector<Set>::const_iterator j;
 
     QDateTime lap_end, lap_start;
-    lap_start = QDateTime(workout.date, workout.time);
+    lap_start = startDateTime(workout.start);
     int snum=0,lnum=0, lap_id=0;
 
     write_event(array, workout, lap_start,false);
@@ -340,7 +340,7 @@ void write_laps(QByteArray *array, const Workout &workout )
     {
         const Set& s = *j;
 
-        lap_end=lap_start.addMSecs(s.duration.msecsSinceStartOfDay() /*- s.rest.msecsSinceStartOfDay()*/); //for timestamp
+        lap_end=lap_start.addMSecs(qMax(s.duration, 0) /*- s.rest*/); //for timestamp
 
         if (s.lens)
         {
@@ -380,9 +380,9 @@ void write_laps(QByteArray *array, const Workout &workout )
             }
 
             int strokes=0;
-            for (int i=0; i< s.lens; ++i)
+            for (int i=0; i< s.count; ++i)
             {
-                strokes += s.strokes[i];
+                strokes += workout.lengthStrokes(s, i);
             }
             
             // Record ------
@@ -391,8 +391,8 @@ void write_laps(QByteArray *array, const Workout &workout )
             write_int16(array, lap_id++);
             write_int32(array, lap_end.toTime_t()-qbase_time.toTime_t());    //timestamp
             write_int32(array, lap_start.toTime_t()-qbase_time.toTime_t());  //lap start
-            write_int32(array, s.duration.msecsSinceStartOfDay());           //elapsed
-            write_int32(array, s.duration.msecsSinceStartOfDay());           //timer // add gap?
+            write_int32(array, qMax(s.duration, 0));           //elapsed
+            write_int32(array, qMax(s.duration, 0));           //timer // add gap?
             write_int32(array, s.dist*100);
             write_int32(array, strokes);
             write_int16(array, s.lens);
@@ -410,11 +410,11 @@ void write_laps(QByteArray *array, const Workout &workout )
 
         // Add rest as a set
         //start event, stop length, stop lap, stop event.
-        lap_end = lap_start.addMSecs(s.rest.msecsSinceStartOfDay()); //for timestamp
+        lap_end = lap_start.addMSecs(qMax(s.rest, 0)); //for timestamp
         snum++;
 
         //Add a rest lap and length if needed, dont tag one at the end.
-        if (s.rest.msecsSinceStartOfDay()>0 && s.lens && snum < (int)workout.sets.size())
+        if (s.rest>0 && s.lens && snum < (int)workout.sets.size())
         {
             write_event(array,workout,lap_start,false);
             write_rest(array,workout, *j, lap_id++, lnum++, lap_start);
@@ -468,15 +468,15 @@ void write_session(QByteArray *array, const Workout &workout )
     // Record ------
     write_int8(array, session_header);
 
-    QDateTime end=QDateTime(workout.date, workout.time).addMSecs(workout.totalduration.msecsSinceStartOfDay());
+    QDateTime end=startDateTime(workout.start).addMSecs(qMax(workout.totalduration, 0));
     fit_value_t value = end.toTime_t();
     write_int32(array, value - qbase_time.toTime_t()); //timestamp
 
-    value = QDateTime(workout.date, workout.time).toTime_t();
+    value = startDateTime(workout.start).toTime_t();
     write_int32(array, value - qbase_time.toTime_t()); //.starttime
 
-    write_int32(array, workout.totalduration.msecsSinceStartOfDay()-workout.rest.msecsSinceStartOfDay()); //.elapsed time
-    write_int32(array, workout.totalduration.msecsSinceStartOfDay());  //.timer time
+    write_int32(array, qMax(workout.totalduration, 0)-qMax(workout.rest, 0)); //.elapsed time
+    write_int32(array, qMax(workout.totalduration, 0));  //.timer time
 
     write_int8(array, 5);                            //.sport - swim
     write_int8(array, 17);                           //. subsport - lap swim
@@ -488,7 +488,7 @@ void write_session(QByteArray *array, const Workout &workout )
     write_int32(array, workout.totaldistance * 100); //. distance
 
     // 9. units //TODO
-    //  if (workout.unit == "m")
+    //  if (workout.unit == poolUnits().find("m"))
     write_int8(array, 0 ); //Metric
 
     //10. pool len
@@ -499,16 +499,10 @@ void write_session(QByteArray *array, const Workout &workout )
     std::vector<Set>::const_iterator j;
     for (j = workout.sets.begin(); j!= workout.sets.end(); ++j)
     {
-
-        std::vector<double>::const_iterator t;
-        for (t = j->times.begin(); t != j->times.end(); ++t)
-        {
-            time += *t;
-        }
-        std::vector<int>::const_iterator k;
-        for (k = j->strokes.begin(); k != j->strokes.end(); ++k)
+        for (int l = 0; l < j->count; ++l)
         {
-            strokes += *k;
+            time += workout.lengthTime(*j, l);
+            strokes += workout.lengthStrokes(*j, l);
         }
     }
     write_int32(array, strokes); //. strokes
@@ -551,7 +545,7 @@ void write_activity(QByteArray *array, const Workout& wrk)
     write_int8(array, activity_header);
 
     //stop time - includes rest
-    QDateTime end=QDateTime(wrk.date, wrk.time).addMSecs(wrk.totalduration.msecsSinceStartOfDay());
+    QDateTime end=startDateTime(wrk.start).addMSecs(qMax(wrk.totalduration, 0));
     fit_value_t value = end.toTime_t();
 
     write_int32(array, value-qbase_time.toTime_t());
@@ -605,7 +599,7 @@ void write_device(QByteArray *array, const Workout &workout )
     int record_header = 0;
     write_int8(array, record_header);
 
-    QDateTime end=QDateTime(workout.date, workout.time).addMSecs(workout.totalduration.msecsSinceStartOfDay());
+    QDateTime end=startDateTime(workout.start).addMSecs(qMax(workout.totalduration, 0));
     fit_value_t value = end.toTime_t();
     write_int32(array, value - qbase_time.toTime_t());
     array->append("Poolmate",9);
@@ -642,7 +636,7 @@ void write_file_id(QByteArray *array, const Workout &workout)
     write_int8(array, record_header);
     write_int8(array, 4); //activity
 
-    QDateTime t(workout.date, workout.time);
+    QDateTime t = startDateTime(workout.start);
     int value = t.toTime_t();  // time_created
     write_int32(array, value - qbase_time.toTime_t());
 
@@ -654,8 +648,12 @@ void write_file_id(QByteArray *array, const Workout &workout)
 }
 
 
-bool fit_write(const QString& filename, const Workout& workout, bool overwrite=false)
+bool fit_write(const QString& filename, const Workout& _workout, bool overwrite=false)
 {
+    // lengths are read once per length below, decode them all up front
+    Workout workout = _workout;
+    workout.table = _workout.table.decoded();
+
     local_type = activity_header = record_header = length_header = lap_header = event_header = session_header = 0;
 
     QFile file(filename);
@@ -0,0 +1,262 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtEndian>
+#include <QByteArray>
+#include <QSaveFile>
+
+#include <string.h>
+
+#include "journal.h"
+#include "binstore.h"
+
+namespace
+{
+const char journal_magic[4] = { 'P', 'V', 'D', 'J' };
+const quint32 journal_version = Journal::format;
+
+// size + checksum ahead of each entry
+const int entry_prefix = 6;
+// seq + op + key
+const int entry_fixed = 17;
+
+bool readAll(const QString &name, QByteArray &blob)
+{
+    QFile file(name);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    blob = file.readAll();
+    return blob.size() >= 8 && memcmp(blob.constData(), journal_magic, 4) == 0;
+}
+
+// Walk complete entries, stopping at any torn write from a crash
+template<class F>
+void walk(const QByteArray &blob, F &f)
+{
+    const uchar *data = (const uchar*)blob.constData();
+    qint64 pos = 8;
+
+    while (pos + entry_prefix <= blob.size())
+    {
+        const quint32 size = qFromLittleEndian<quint32>(data + pos);
+        const quint16 crc = qFromLittleEndian<quint16>(data + pos + 4);
+        const qint64 start = pos + entry_prefix;
+
+        if (size < (quint32)entry_fixed || start + size > blob.size())
+            break;
+        if (qChecksum((const char*)data + start, size) != crc)
+            break;
+
+        if (!f(data + start, size, pos, start + size))
+            break;
+        pos = start + size;
+    }
+}
+} //namespace
+
+Journal::Journal()
+{
+    seq = 0;
+}
+
+bool Journal::read(const QString &name, quint64 after, std::vector<Entry>& entries, int *version)
+{
+    QByteArray blob;
+    if (!readAll(name, blob))
+        return false;
+
+    if (version)
+        *version = qFromLittleEndian<quint32>((const uchar*)blob.constData() + 4);
+
+    struct Reader
+    {
+        quint64 after;
+        std::vector<Entry> *entries;
+
+        bool operator()(const uchar *p, quint32 size, qint64, qint64)
+        {
+            Entry e;
+            e.seq = qFromLittleEndian<quint64>(p);
+            e.op = p[8];
+            e.key = (qint64)qFromLittleEndian<quint64>(p + 9);
+
+            if (e.seq <= after)
+                return true;
+
+            if (e.op == ADD || e.op == REPLACE)
+            {
+                std::vector<Workout> w;
+                if (!DecodeWorkouts(p + entry_fixed, size - entry_fixed, w) || w.size() != 1)
+                    return false;
+                e.workout = w[0];
+            }
+            else if (e.op == SYNC)
+            {
+                for (quint32 i = entry_fixed; i + 4 <= size; i += 4)
+                    e.ids.push_back(qFromLittleEndian<qint32>(p + i));
+            }
+            entries->push_back(e);
+            return true;
+        }
+    } reader = { after, &entries };
+
+    walk(blob, reader);
+    return true;
+}
+
+bool Journal::open(const QString &name, quint64 last)
+{
+    close();
+    seq = last;
+
+    file.setFileName(name);
+
+    // Entries in another format may not be in the data file, so they
+    // are neither appended to nor thrown away
+    QByteArray blob;
+    const bool found = readAll(name, blob);
+    if (found && qFromLittleEndian<quint32>((const uchar*)blob.constData() + 4) != journal_version)
+        return false;
+
+    // Start a fresh file if missing or unreadable
+    if (!found)
+    {
+        if (!file.open(QIODevice::WriteOnly|QIODevice::Truncate))
+            return false;
+
+        QByteArray header(journal_magic, 4);
+        uchar b[4];
+        qToLittleEndian(journal_version, b);
+        header.append((const char*)b, 4);
+        file.write(header);
+        file.flush();
+        return true;
+    }
+
+    // Continue numbering after the last entry, dropping any torn tail
+    struct Last
+    {
+        quint64 *seq;
+        qint64 end;
+
+        bool operator()(const uchar *p, quint32, qint64, qint64 next)
+        {
+            *seq = qMax(*seq, qFromLittleEndian<quint64>(p));
+            end = next;
+            return true;
+        }
+    } tail = { &seq, 8 };
+    walk(blob, tail);
+
+    if (!file.open(QIODevice::ReadWrite))
+        return false;
+    if (tail.end < blob.size())
+        file.resize(tail.end);
+    file.seek(tail.end);
+    return true;
+}
+
+void Journal::close()
+{
+    if (file.isOpen())
+        file.close();
+}
+
+bool Journal::append(int op, qint64 key, const Workout *workout)
+{
+    QByteArray payload;
+    if (workout)
+        EncodeWorkouts(workout, workout + 1, payload);
+    return write(op, key, payload);
+}
+
+bool Journal::append(int op, qint64 key, const std::vector<int> &ids)
+{
+    QByteArray payload;
+    uchar b[4];
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        qToLittleEndian((qint32)ids[i], b);
+        payload.append((const char*)b, 4);
+    }
+    return write(op, key, payload);
+}
+
+bool Journal::write(int op, qint64 key, const QByteArray &payload)
+{
+    if (!file.isOpen())
+        return false;
+
+    QByteArray entry;
+    uchar b[8];
+
+    qToLittleEndian(++seq, b);
+    entry.append((const char*)b, 8);
+    entry.append((char)op);
+    qToLittleEndian((quint64)key, b);
+    entry.append((const char*)b, 8);
+    entry.append(payload);
+
+    QByteArray prefix;
+    qToLittleEndian((quint32)entry.size(), b);
+    prefix.append((const char*)b, 4);
+    qToLittleEndian(qChecksum(entry.constData(), entry.size()), b);
+    prefix.append((const char*)b, 2);
+
+    bool ok = file.write(prefix) == prefix.size() &&
+            file.write(entry) == entry.size();
+    file.flush();
+    return ok;
+}
+
+bool Journal::discard(quint64 upto)
+{
+    if (!file.isOpen())
+        return false;
+
+    const QString name = file.fileName();
+    file.close();
+
+    QByteArray blob;
+    if (!readAll(name, blob))
+        return open(name, seq);
+
+    // Keep header and anything appended since upto
+    struct Keep
+    {
+        quint64 upto;
+        QByteArray *out;
+        const QByteArray *in;
+
+        bool operator()(const uchar *p, quint32, qint64 from, qint64 to)
+        {
+            if (qFromLittleEndian<quint64>(p) > upto)
+                out->append(in->constData() + from, to - from);
+            return true;
+        }
+    };
+
+    QByteArray kept = blob.left(8);
+    Keep keep = { upto, &kept, &blob };
+    walk(blob, keep);
+
+    QSaveFile out(name);
+    if (out.open(QIODevice::WriteOnly) && out.write(kept) == kept.size())
+        out.commit();
+    return open(name, seq);
+}
@@ -0,0 +1,85 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <vector>
+#include <QFile>
+
+#include "datastore.h"
+
+/*
+ * Append only log of DataStore changes.
+ *
+ * Every change is written as it happens so the main data file only
+ * needs rewriting occasionally. Each entry carries a sequence number,
+ * the main file records the last one it includes so anything later is
+ * replayed on load.
+ */
+class Journal
+{
+public:
+    enum Op
+    {
+        ADD = 1,        // append workout
+        REPLACE,        // replace workout with id key
+        REMOVE,         // remove workout with id key
+        REMOVE_ALL,     // remove all workouts starting at time key
+        SYNC            // add sync flags key to the workouts with ids
+    };
+
+    struct Entry
+    {
+        quint64 seq;
+        int op;
+        qint64 key;
+        Workout workout;
+        std::vector<int> ids;
+    };
+
+    Journal();
+
+    // Read entries later than sequence number 'after'
+    static bool read(const QString &name, quint64 after, std::vector<Entry>& entries, int *version = 0);
+
+    static const int format = 1;
+
+    // Open for appending, numbering continues after 'last'. A journal
+    // in another format is not touched and false returned.
+    bool open(const QString &name, quint64 last);
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+
+    bool append(int op, qint64 key, const Workout *workout = 0);
+    bool append(int op, qint64 key, const std::vector<int> &ids);
+
+    // Drop entries up to and including seq once they are in the main file
+    bool discard(quint64 seq);
+
+    quint64 sequence() const { return seq; }
+    qint64 size() const { return file.size(); }
+
+private:
+    bool write(int op, qint64 key, const QByteArray &payload);
+
+    QFile file;
+    quint64 seq;
+};
+
+#endif
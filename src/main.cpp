@@ -16,6 +16,7 @@
  * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <QApplication>
+#include <QMessageBox>
 #include <QSettings>
 
 #include "summaryimpl.h"
@@ -40,16 +41,33 @@ int main(int argc, char ** argv)
     }
 
     const bool backup = settings.value("backup").toBool();
+    const int backupKeep = settings.value("backupKeep", 20).toInt();
+    const bool csvExport = settings.value("csvExport").toBool();
+    const int loadThreads = settings.value("loadThreads").toInt(); // 0 - one per core
+    const bool lazyLoad = settings.value("lazyLoad").toBool();
+    const bool database = settings.value("database").toBool();
+    const int autosaveMinutes = settings.value("autosaveMinutes", 5).toInt();
+    const int autosaveEdits = settings.value("autosaveEdits", 50).toInt();
 
     DataStore d;
     d.setFile(path);
     d.setBackup(backup);
+    d.setBackupKeep(backupKeep);
+    d.setCsvExport(csvExport);
+    d.setLoadThreads(loadThreads);
+    d.setLazyLoad(lazyLoad);
+    d.setDatabase(database);
+    d.setAutosaveEdits(autosaveEdits);
     d.load();
 
     QApplication app( argc, argv );
 
+    if (!d.loadError().isEmpty())
+        QMessageBox::warning(0, QObject::tr("PoolMate Viewer"), d.loadError());
+
     SummaryImpl win;
     win.setDataStore( &d );
+    win.setAutosave(autosaveMinutes);
 
     //TODO tidy this!, for now refill grid and data from datastore.
     if (d.Workouts().size())
@@ -287,11 +287,10 @@ void PodLive::getData( std::vector<ExerciseSet>& exdata )
                         ExerciseSet set;
                         set.sync = 0;
                         set.user = 1;    // retrieve
-                        set.date = date;
-                        set.time = time;
-                        set.totalduration = t_dur;
+                        set.start = toStart(date, time);
+                        set.totalduration = toMsecs(t_dur);
                         set.set = setnum++;
-                        set.duration = dur;
+                        set.duration = toMsecs(dur);
 
                         if (id == 0x82) //Chrono
                         {
@@ -322,7 +321,7 @@ void PodLive::getData( std::vector<ExerciseSet>& exdata )
                             //For some reason Swimovate goes off the duration not the total seconds:
                             int setsecs = ((dur.hour()*60+dur.minute())*60+dur.second());
 
-                            set.rest = rest;
+                            set.rest = toMsecs(rest);
 
                             if (lens)
                             {
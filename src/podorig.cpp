@@ -127,12 +127,11 @@ void dataToWorkouts(const unsigned char *buf, std::vector<ExerciseSet>& data )
                     ExerciseSet set;
                     set.sync = 0;
                     set.user = user;
-                    set.date = date;
-                    set.time = time;
+                    set.start = toStart(date, time);
                     set.type = type;
-                    set.totalduration = t_dur;
+                    set.totalduration = toMsecs(t_dur);
                     set.set = j+1;
-                    set.duration = dur;
+                    set.duration = toMsecs(dur);
 
                     set.cal = cal;
                     set.unit = units;
@@ -185,12 +184,11 @@ void dataToWorkouts(const unsigned char *buf, std::vector<ExerciseSet>& data )
                     ExerciseSet set;
                     set.sync = 0;
                     set.user = user;
-                    set.date = date;
-                    set.time = time;
+                    set.start = toStart(date, time);
                     set.type = type;
-                    set.totalduration = t_dur;
+                    set.totalduration = toMsecs(t_dur);
                     set.set = j+1;
-                    set.duration = dur;
+                    set.duration = toMsecs(dur);
 
                     data.push_back(set);
                 }
@@ -0,0 +1,344 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <QVariant>
+
+#include "sqlstore.h"
+
+namespace {
+// Names rather than codes are stored, codes only last one run
+const char *const schema[] = {
+    "CREATE TABLE IF NOT EXISTS workouts ("
+    " id INTEGER PRIMARY KEY, user INTEGER, start INTEGER, type TEXT,"
+    " pool INTEGER, unit TEXT, duration INTEGER, rest INTEGER,"
+    " max_eff INTEGER, avg_eff INTEGER, min_eff INTEGER, cal INTEGER,"
+    " lengths INTEGER, distance INTEGER, sync INTEGER)",
+    // years are read and replaced by start, queries run on the rows in memory
+    "CREATE INDEX IF NOT EXISTS workouts_start ON workouts (start)",
+    // num orders rows within a workout, lengths counts the set's rows in lengths
+    "CREATE TABLE IF NOT EXISTS sets ("
+    " workout INTEGER, num INTEGER, setnum INTEGER, duration INTEGER,"
+    " lens INTEGER, strk INTEGER, dist INTEGER, speed INTEGER, effic INTEGER,"
+    " rate INTEGER, rest INTEGER, fnum REAL, lengths INTEGER,"
+    " PRIMARY KEY (workout, num)) WITHOUT ROWID",
+    "CREATE TABLE IF NOT EXISTS lengths ("
+    " workout INTEGER, num INTEGER, time INTEGER, strokes INTEGER, style TEXT,"
+    " PRIMARY KEY (workout, num)) WITHOUT ROWID",
+    "CREATE TABLE IF NOT EXISTS meta (name TEXT PRIMARY KEY, value INTEGER)",
+    0
+};
+
+// Rows of the workouts starting in a range, see SqlStore::read()
+const char in_range[] = "workout IN (SELECT id FROM workouts WHERE start >= ? AND start < ?)";
+
+bool startBefore(const Workout &w, qint64 start)
+{
+    return w.start < start;
+}
+} //namespace
+
+SqlStore::SqlStore()
+    : connection(QString("poolviewer-%1").arg((quintptr)this))
+{
+}
+
+SqlStore::~SqlStore()
+{
+    close();
+}
+
+bool SqlStore::open(const QString &name)
+{
+    close();
+
+    db = QSqlDatabase::addDatabase("QSQLITE", connection);
+    db.setDatabaseName(name);
+    if (!db.open())
+    {
+        close();
+        return false;
+    }
+
+    QSqlQuery query(db);
+    // commits only wait for the log, not the whole database
+    query.exec("PRAGMA journal_mode=WAL");
+    query.exec("PRAGMA synchronous=NORMAL");
+
+    for (const char *const *sql = schema; *sql; ++sql)
+    {
+        if (!query.exec(*sql))
+        {
+            close();
+            return false;
+        }
+    }
+
+    if (!prepare())
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SqlStore::close()
+{
+    // queries and handle have to go before the connection is removed
+    addWorkout = QSqlQuery();
+    addSet = QSqlQuery();
+    addLength = QSqlQuery();
+    if (db.isValid())
+    {
+        db.close();
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(connection);
+    }
+}
+
+bool SqlStore::prepare()
+{
+    addWorkout = QSqlQuery(db);
+    addSet = QSqlQuery(db);
+    addLength = QSqlQuery(db);
+    return addWorkout.prepare("INSERT INTO workouts VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)") &&
+            addSet.prepare("INSERT INTO sets VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?)") &&
+            addLength.prepare("INSERT INTO lengths VALUES (?,?,?,?,?)");
+}
+
+bool SqlStore::isEmpty()
+{
+    QSqlQuery query(db);
+    return !query.exec("SELECT 1 FROM workouts LIMIT 1") || !query.next();
+}
+
+quint64 SqlStore::sequence()
+{
+    QSqlQuery query(db);
+    if (!query.exec("SELECT value FROM meta WHERE name = 'sequence'") || !query.next())
+        return 0;
+    return query.value(0).toULongLong();
+}
+
+qint64 SqlStore::lastStart()
+{
+    QSqlQuery query(db);
+    if (!query.exec("SELECT MAX(start) FROM workouts") || !query.next() || query.isNull(0))
+        return NO_START;
+    return query.value(0).toLongLong();
+}
+
+bool SqlStore::read(std::vector<Workout>& dst, qint64 from, qint64 to)
+{
+    QSqlQuery w(db), s(db), l(db);
+    w.setForwardOnly(true);
+    s.setForwardOnly(true);
+    l.setForwardOnly(true);
+
+    // all three in workout order so they can be merged in one pass
+    if (!w.prepare("SELECT id, user, start, type, pool, unit, duration, rest, max_eff, avg_eff,"
+                   " min_eff, cal, lengths, distance, sync FROM workouts"
+                   " WHERE start >= ? AND start < ? ORDER BY id") ||
+        !s.prepare(QString("SELECT workout, setnum, duration, lens, strk, dist, speed, effic, rate,"
+                           " rest, fnum, lengths FROM sets WHERE %1 ORDER BY workout, num").arg(in_range)) ||
+        !l.prepare(QString("SELECT workout, time, strokes, style FROM lengths"
+                           " WHERE %1 ORDER BY workout, num").arg(in_range)))
+        return false;
+
+    QSqlQuery *queries[] = { &w, &s, &l };
+    for (int q = 0; q < 3; ++q)
+    {
+        queries[q]->addBindValue(from);
+        queries[q]->addBindValue(to);
+        if (!queries[q]->exec())
+            return false;
+    }
+
+    // lengths of every workout go in one block
+    QExplicitlySharedDataPointer<LengthBlock> block(new LengthBlock);
+
+    bool sets = s.next();
+    bool lengths = l.next();
+    while (w.next())
+    {
+        Workout wrk;
+        wrk.id = w.value(0).toInt();
+        wrk.user = w.value(1).toInt();
+        wrk.start = w.value(2).toLongLong();
+        wrk.type = workoutTypes().code(w.value(3).toString());
+        wrk.pool = w.value(4).toInt();
+        wrk.unit = poolUnits().code(w.value(5).toString());
+        wrk.totalduration = w.value(6).toInt();
+        wrk.rest = w.value(7).toInt();
+        wrk.max_eff = w.value(8).toInt();
+        wrk.avg_eff = w.value(9).toInt();
+        wrk.min_eff = w.value(10).toInt();
+        wrk.cal = w.value(11).toInt();
+        wrk.lengths = w.value(12).toInt();
+        wrk.totaldistance = w.value(13).toInt();
+        wrk.sync = w.value(14).toInt();
+
+        while (sets && s.value(0).toInt() < wrk.id)
+            sets = s.next();
+
+        int count = 0;
+        for (; sets && s.value(0).toInt() == wrk.id; sets = s.next())
+        {
+            Set set;
+            set.set = s.value(1).toInt();
+            set.duration = s.value(2).toInt();
+            set.lens = s.value(3).toInt();
+            set.strk = s.value(4).toInt();
+            set.dist = s.value(5).toInt();
+            set.speed = s.value(6).toInt();
+            set.effic = s.value(7).toInt();
+            set.rate = s.value(8).toInt();
+            set.rest = s.value(9).toInt();
+            set.num = s.value(10).toDouble();
+            set.first = count;
+            set.count = s.value(11).toInt();
+            count += set.count;
+            wrk.sets.push_back(set);
+        }
+
+        while (lengths && l.value(0).toInt() < wrk.id)
+            lengths = l.next();
+
+        const int base = block->times.size();
+        for (; lengths && l.value(0).toInt() == wrk.id; lengths = l.next())
+        {
+            block->append(l.value(1).toInt(), l.value(2).toInt(),
+                          strokeStyles().code(l.value(3).toString()));
+        }
+
+        // sets and lengths are always written together
+        if ((int)block->times.size() - base != count)
+            return false;
+
+        wrk.table = LengthTable(block.data(), base, count);
+        dst.push_back(wrk);
+    }
+    return true;
+}
+
+bool SqlStore::insertRows(const Workout &workout)
+{
+    addWorkout.addBindValue(workout.id);
+    addWorkout.addBindValue(workout.user);
+    addWorkout.addBindValue(workout.start);
+    addWorkout.addBindValue(workoutTypes().name(workout.type));
+    addWorkout.addBindValue(workout.pool);
+    addWorkout.addBindValue(poolUnits().name(workout.unit));
+    addWorkout.addBindValue(workout.totalduration);
+    addWorkout.addBindValue(workout.rest);
+    addWorkout.addBindValue(workout.max_eff);
+    addWorkout.addBindValue(workout.avg_eff);
+    addWorkout.addBindValue(workout.min_eff);
+    addWorkout.addBindValue(workout.cal);
+    addWorkout.addBindValue(workout.lengths);
+    addWorkout.addBindValue(workout.totaldistance);
+    addWorkout.addBindValue(workout.sync);
+    if (!addWorkout.exec())
+        return false;
+
+    const LengthTable lengths = workout.table.decoded();
+    int num = 0;
+    for (size_t n = 0; n < workout.sets.size(); ++n)
+    {
+        const Set &set = workout.sets[n];
+        addSet.addBindValue(workout.id);
+        addSet.addBindValue((int)n);
+        addSet.addBindValue(set.set);
+        addSet.addBindValue(set.duration);
+        addSet.addBindValue(set.lens);
+        addSet.addBindValue(set.strk);
+        addSet.addBindValue(set.dist);
+        addSet.addBindValue(set.speed);
+        addSet.addBindValue(set.effic);
+        addSet.addBindValue(set.rate);
+        addSet.addBindValue(set.rest);
+        addSet.addBindValue(set.num);
+        addSet.addBindValue(set.count);
+        if (!addSet.exec())
+            return false;
+
+        for (int l = 0; l < set.count; ++l, ++num)
+        {
+            addLength.addBindValue(workout.id);
+            addLength.addBindValue(num);
+            addLength.addBindValue(lengths.time(set.first + l));
+            addLength.addBindValue(lengths.strokes(set.first + l));
+            addLength.addBindValue(strokeStyles().name(lengths.style(set.first + l)));
+            if (!addLength.exec())
+                return false;
+        }
+    }
+    return true;
+}
+
+// Delete the workouts starting in [from, to), with their sets and lengths
+bool SqlStore::removeRows(qint64 from, qint64 to)
+{
+    QSqlQuery lengths(db), sets(db), workouts(db);
+    if (!lengths.prepare(QString("DELETE FROM lengths WHERE %1").arg(in_range)) ||
+        !sets.prepare(QString("DELETE FROM sets WHERE %1").arg(in_range)) ||
+        !workouts.prepare("DELETE FROM workouts WHERE start >= ? AND start < ?"))
+        return false;
+
+    QSqlQuery *queries[] = { &lengths, &sets, &workouts };
+    for (int q = 0; q < 3; ++q)
+    {
+        queries[q]->addBindValue(from);
+        queries[q]->addBindValue(to);
+        if (!queries[q]->exec())
+            return false;
+    }
+    return true;
+}
+
+bool SqlStore::write(const std::vector<Workout>& rows, const Ranges &ranges, quint64 sequence)
+{
+    if (!db.transaction())
+        return false;
+
+    bool ok = true;
+    for (int r = 0; ok && r < ranges.size(); ++r)
+    {
+        const qint64 from = ranges[r].first;
+        const qint64 to = ranges[r].second;
+        ok = removeRows(from, to);
+
+        std::vector<Workout>::const_iterator i;
+        for (i = std::lower_bound(rows.begin(), rows.end(), from, startBefore);
+             ok && i != rows.end() && i->start < to; ++i)
+            ok = insertRows(*i);
+    }
+
+    QSqlQuery query(db);
+    ok = ok && query.prepare("INSERT OR REPLACE INTO meta VALUES ('sequence', ?)");
+    if (ok)
+    {
+        query.addBindValue(sequence);
+        ok = query.exec();
+    }
+
+    if (ok && db.commit())
+        return true;
+    db.rollback();
+    return false;
+}
@@ -0,0 +1,83 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SQLSTORE_H
+#define SQLSTORE_H
+
+#include <vector>
+#include <QList>
+#include <QPair>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+
+#include "datastore.h"
+
+/*
+ * Workouts kept in a local SQLite database.
+ *
+ * Read by year in place of the .pvd data files, through the index on
+ * start. Workouts, sets and lengths are separate tables, written a
+ * batch of years at a time in one transaction along with the journal
+ * sequence they cover. A connection only works on the thread that
+ * opened it, so background saves open their own.
+ */
+class SqlStore
+{
+public:
+    SqlStore();
+    ~SqlStore();
+
+    // Open or create the database file and its tables
+    bool open(const QString &name);
+    void close();
+    bool isOpen() const { return db.isOpen(); }
+
+    // true until workouts have been written
+    bool isEmpty();
+
+    // Last journal entry the stored workouts include, 0 if none
+    quint64 sequence();
+
+    // Latest start stored, NO_START if none
+    qint64 lastStart();
+
+    // Append the workouts starting in [from, to) to dst, in id order
+    bool read(std::vector<Workout>& dst, qint64 from, qint64 to);
+
+    // Starts [from, to)
+    typedef QList<QPair<qint64, qint64> > Ranges;
+
+    // Replace what is stored in each range with the workouts of rows,
+    // sorted by start, in one transaction that records sequence
+    bool write(const std::vector<Workout>& rows, const Ranges &ranges, quint64 sequence);
+
+private:
+    bool prepare();
+    bool insertRows(const Workout &workout);
+    bool removeRows(qint64 from, qint64 to);
+
+    QString connection;
+    QSqlDatabase db;
+
+    // prepared once, reused for every workout written
+    QSqlQuery addWorkout;
+    QSqlQuery addSet;
+    QSqlQuery addLength;
+};
+
+#endif
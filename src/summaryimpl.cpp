@@ -55,9 +55,52 @@ SummaryImpl::SummaryImpl( QWidget * parent, Qt::WindowFlags f)
     tabs->setTabEnabled(0,false);
     tabs->setCurrentIndex(1);
 
+    garmin = QPixmap(":/images/garmin.png");
+    strava = QPixmap(":/images/strava.png");
+    tick = QPixmap(":/images/tick.png");
+
+    connect(&autosaveTimer, SIGNAL(timeout()), this, SLOT(autosave()));
+    connect(calendarWidget, SIGNAL(currentPageChanged(int,int)), this, SLOT(calendarPage(int,int)));
+
     //    setEscapeButton(pushButton);
 }
 
+// Views are patched from the data store's change signals
+void SummaryImpl::setDataStore(DataStore *_ds)
+{
+    ds = _ds;
+    connect(ds, SIGNAL(workoutInserted(int)), this, SLOT(workoutInserted(int)));
+    connect(ds, SIGNAL(workoutRemoved(int)), this, SLOT(workoutRemoved(int)));
+    connect(ds, SIGNAL(workoutModified(int)), this, SLOT(workoutModified(int)));
+    connect(ds, SIGNAL(setModified(int,int)), this, SLOT(setModified(int,int)));
+    connect(ds, SIGNAL(syncChanged(int)), this, SLOT(syncChanged(int)));
+    connect(ds, SIGNAL(workoutsReset()), this, SLOT(workoutsReset()));
+}
+
+void SummaryImpl::setAutosave(int minutes)
+{
+    if (minutes > 0)
+        autosaveTimer.start(minutes * 60000);
+    else
+        autosaveTimer.stop();
+}
+
+// Only starts the write, the data store saves on a worker thread
+void SummaryImpl::autosave()
+{
+    ds->autosave();
+}
+
+// Older years are read as the calendar reaches them
+void SummaryImpl::calendarPage(int year, int month)
+{
+    // the first week shown can start in the month before. The
+    // views are refilled on the reset this sends, which moves the page
+    // but not the workout selected.
+    if (ds->loadFrom(QDate(year, month, 1).addDays(-7)))
+        calendarWidget->setCurrentPage(year, month);
+}
+
 void SummaryImpl::scaleChanged(int sc)
 {
     scale = (Scale)sc;
@@ -164,9 +207,10 @@ void SummaryImpl::setData( const std::vector<Workout>& workouts)
     if (scale == WORKOUTS)
     {
         int row = 0;
-        if (ds->Workouts().size())
+        const Workout* selected = ds->getWorkout(selectedId());
+        if (selected)
         {
-            const Workout& workout = ds->Workouts()[workoutGrid->currentRow()];
+            const Workout& workout = *selected;
 
             std::vector<Set>::const_iterator i;
             for (i = workout.sets.begin(); i != workout.sets.end(); ++i)
@@ -178,23 +222,26 @@ void SummaryImpl::setData( const std::vector<Workout>& workouts)
                 graphWidget->series[3].integers.push_back(i->rate);
             }
 
-            if (workout.sets[0].times.size())
+            if (workout.sets[0].count)
             {
                 int n=0;
+                const LengthTable lengths = workout.table.decoded();
                 std::vector<Set>::const_iterator i;
                 for (i = workout.sets.begin(); i != workout.sets.end(); ++i)
                 {
                     int j;
-                    for ( j=0; j < i->lens; ++j )
+                    for ( j=0; j < i->count; ++j )
                     {
-                        double rate = 60 * i->strokes[j]/i->times[j];
-                        int effic = ((25 * i->times[j]) + (25*i->strokes[j]))/workout.pool;
+                        const double time = lengths.time(i->first + j) / 1000.0;
+                        const int strokes = lengths.strokes(i->first + j);
+                        double rate = 60 * strokes/time;
+                        int effic = ((25 * time) + (25*strokes))/workout.pool;
 
                         lengthWidget->xaxis.push_back(QString::number(++n));
 
                         lengthWidget->series[0].integers.push_back(effic);
-                        lengthWidget->series[1].integers.push_back(100*i->times[j]/workout.pool);
-                        lengthWidget->series[2].doubles.push_back((double)workout.pool/i->strokes[j]);
+                        lengthWidget->series[1].integers.push_back(100*time/workout.pool);
+                        lengthWidget->series[2].doubles.push_back((double)workout.pool/strokes);
                         lengthWidget->series[3].integers.push_back(rate);
                     }
                     lengthWidget->xaxis.push_back(QString());
@@ -208,42 +255,59 @@ void SummaryImpl::setData( const std::vector<Workout>& workouts)
     }
     else
     {
-        std::vector<Workout>::const_iterator i;
-        for ( i = workouts.begin(); i != workouts.end(); ++i)
+        // Volume from the running totals, one bar per day, week or month
+        Aggregates::Period period = Aggregates::DAY;
+        if (scale == YEARBYWEEK)
+            period = Aggregates::WEEK;
+        else if (scale == YEARBYMONTH)
+            period = Aggregates::MONTH;
+
+        const Aggregates::Buckets buckets = ds->totals(period, Aggregates::periodStart(period, start), end.addDays(1));
+        Aggregates::Buckets::const_iterator b;
+        for (b = buckets.begin(); b != buckets.end(); ++b)
         {
-            if ( (i->type == "Swim"|| i->type=="SwimHR") &&
-                 i->date >= start &&
-                 i->date <= end)
-            {
-                QString axLabel;
-                if (scale == YEARBYWEEK)
-                    axLabel=QString("%1")
-                            .arg(i->date.weekNumber());
-                else if (scale == YEARBYMONTH)
-                    axLabel=i->date.toString("MMM");
-                else
-                    axLabel=i->date.toString("dd/MM");
-                volumeWidget->xaxis.push_back(axLabel);
+            volumeWidget->xaxis.push_back(axisLabel(b->first));
 
-                volumeWidget->series[0].integers.push_back(i->cal);
-                volumeWidget->series[1].integers.push_back(i->totaldistance);
-                volumeWidget->series[2].seconds.push_back(QTime(0,0,0).secsTo(i->rest));
-                volumeWidget->series[3].seconds.push_back(QTime(0,0,0).secsTo(i->totalduration));
+            volumeWidget->series[0].integers.push_back(b->second.cal);
+            volumeWidget->series[1].integers.push_back(b->second.dist);
+            volumeWidget->series[2].seconds.push_back(b->second.rest / 1000);
+            volumeWidget->series[3].seconds.push_back(b->second.duration / 1000);
+        }
 
-                std::vector<Set>::const_iterator j;
-                for (j = i->sets.begin(); j != i->sets.end(); ++j)
-                {
-                    graphWidget->xaxis.push_back( axLabel );
-                    graphWidget->series[0].integers.push_back(j->effic);
-                    graphWidget->series[1].integers.push_back(j->speed);
-                    graphWidget->series[2].doubles.push_back( j->strk ? (double)i->pool/j->strk : 0.0 );
-                    graphWidget->series[3].integers.push_back(j->rate);
-                }
+        WorkoutQuery swims = WorkoutQuery::swims();
+        swims.from = toStart(start, QTime(0,0));
+        swims.to = toStart(end.addDays(1), QTime(0,0));
+
+        const WorkoutView view = ds->query(swims);
+        WorkoutView::const_iterator i;
+        for (i = view.begin(); i != view.end(); ++i)
+        {
+            const QString axLabel = axisLabel(startDate(i->start));
+
+            std::vector<Set>::const_iterator j;
+            for (j = i->sets.begin(); j != i->sets.end(); ++j)
+            {
+                graphWidget->xaxis.push_back( axLabel );
+                graphWidget->series[0].integers.push_back(j->effic);
+                graphWidget->series[1].integers.push_back(j->speed);
+                graphWidget->series[2].doubles.push_back( j->strk ? (double)i->pool/j->strk : 0.0 );
+                graphWidget->series[3].integers.push_back(j->rate);
             }
         }
     }
 }
 
+// Label of a date on the graphs at the current scale
+QString SummaryImpl::axisLabel( const QDate &date ) const
+{
+    if (scale == YEARBYWEEK)
+        return QString("%1").arg(date.weekNumber());
+    else if (scale == YEARBYMONTH)
+        return date.toString("MMM");
+    else
+        return date.toString("dd/MM");
+}
+
 void SummaryImpl::fillWorkouts( const std::vector<Workout>& workouts)
 {
     workoutGrid->clearContents();
@@ -253,114 +317,182 @@ void SummaryImpl::fillWorkouts( const std::vector<Workout>& workouts)
 
     workoutGrid->setRowCount(workouts.size());
 
+    int row=0;
+    for ( i = workouts.begin(); i != workouts.end(); ++i)
+        fillRow(row++, *i);
+
+    // Calendar shading from the data store's day totals
     std::map<QDate, CalendarWidget::Totals> day_totals;
-    std::map<QDate, int> day_nums;
+    const Aggregates::Buckets days = ds->totals(Aggregates::DAY, QDate(), QDate());
+    Aggregates::Buckets::const_iterator d;
+    for (d = days.begin(); d != days.end(); ++d)
+        day_totals[d->first] = dayTotals(d->second);
 
-    QPixmap garmin(":/images/garmin.png");
-    QPixmap strava(":/images/strava.png");
-    QPixmap tick(":/images/tick.png");
-    QPixmap icons(48,16);
+    workoutGrid->selectRow(workoutGrid->rowCount()-1);
+    workoutGrid->resizeColumnsToContents();
 
-    int row=0;
-    for ( i = workouts.begin(); i != workouts.end(); ++i)
-    {
-        if (i->max_eff > day_totals[i->date].max_eff)
-        {
-            day_totals[i->date].max_eff = i->max_eff;
-        }
+    //populate graph
+    setData(ds->Workouts());
+    calendarWidget->setData(day_totals);
+}
 
-        day_totals[i->date].dist += i->totaldistance;
-        day_totals[i->date].avg_eff += i->avg_eff;
-        day_nums[i->date] = day_nums[i->date]+1;;
+// Set the cells of one row of the workout grid
+void SummaryImpl::fillRow( int row, const Workout& wrk )
+{
+    int col=0;
+    QTableWidgetItem *item;
 
-        if (i->min_eff < day_totals[i->date].min_eff || day_totals[i->date].min_eff == 0)
-        {
-            day_totals[i->date].min_eff = i->min_eff;
-        }
+    item = createTableWidgetItem(QVariant(startDate(wrk.start)));
+    item->setData(WORKOUT_ID, QVariant(wrk.id));
+    workoutGrid->setItem( row, col++, item );
 
-        int col=0;
-        QTableWidgetItem *item;
+    item = createTableWidgetItem(QVariant(startTime(wrk.start)));
+    workoutGrid->setItem( row, col++, item );
 
-        item = createTableWidgetItem(QVariant(i->date));
+    if (wrk.type == TYPE_SWIM || wrk.type == TYPE_SWIMHR)
+    {
+        item = createTableWidgetItem(QVariant(wrk.pool));
         workoutGrid->setItem( row, col++, item );
 
-        item = createTableWidgetItem(QVariant(i->time));
+        item = createTableWidgetItem(QVariant(msecsToTime(wrk.totalduration).toString()));
         workoutGrid->setItem( row, col++, item );
 
-        if (i->type == "Swim" || i->type=="SwimHR")
-        {
-            item = createTableWidgetItem(QVariant(i->pool));
-            workoutGrid->setItem( row, col++, item );
+        item = createTableWidgetItem(QVariant(wrk.lengths));
+        workoutGrid->setItem( row, col++, item );
 
-            item = createTableWidgetItem(QVariant(i->totalduration.toString()));
-            workoutGrid->setItem( row, col++, item );
+        item = createTableWidgetItem(QVariant(wrk.totaldistance));
+        workoutGrid->setItem( row, col++, item );
 
-            item = createTableWidgetItem(QVariant(i->lengths));
-            workoutGrid->setItem( row, col++, item );
+        item = createTableWidgetItem(QVariant(wrk.cal));
+        workoutGrid->setItem( row, col++, item );
 
-            item = createTableWidgetItem(QVariant(i->totaldistance));
-            workoutGrid->setItem( row, col++, item );
+        item = createTableWidgetItem(QVariant(msecsToTime(wrk.rest).toString()));
+        workoutGrid->setItem( row, col++, item );
 
-            item = createTableWidgetItem(QVariant(i->cal));
-            workoutGrid->setItem( row, col++, item );
+        QPixmap icons(48,16);
+        icons.fill(Qt::transparent);
 
-            item = createTableWidgetItem(QVariant(i->rest.toString()));
-            workoutGrid->setItem( row, col++, item );
+        QPainter painter(&icons);
+        int pos=0;
 
-            icons.fill(Qt::transparent);
+        if (wrk.sync & SYNC_FIT)
+        {
+            painter.drawPixmap(pos,0,16,16,tick);
+            pos+=16;
+        }
+        if (wrk.sync & SYNC_GARMIN)
+        {
+            painter.drawPixmap(pos,0,16,16,garmin);
+            pos+=16;
+        }
+        if (wrk.sync & SYNC_STRAVA)
+        {
+            painter.drawPixmap(pos,0,16,16,strava);
+            pos+=16;
+        }
 
-            QPainter painter(&icons);
-            int pos=0;
+        QIcon cell(icons);
 
-            if (i->sync & SYNC_FIT)
-            {
-                painter.drawPixmap(pos,0,16,16,tick);
-                pos+=16;
-            }
-            if (i->sync & SYNC_GARMIN)
-            {
-                painter.drawPixmap(pos,0,16,16,garmin);
-                pos+=16;
-            }
-            if (i->sync & SYNC_STRAVA)
-            {
-                painter.drawPixmap(pos,0,16,16,strava);
-                pos+=16;
-            }
+        item = new QTableWidgetItem();
+        item->setFlags(item->flags() ^ Qt::ItemIsEditable);
+        item->setIcon(cell);
+        workoutGrid->setItem( row, col++, item );
+    }
 
-            QIcon cell(icons);
+    // a reused row may have had more
+    for (; col < workoutGrid->columnCount(); ++col)
+        delete workoutGrid->takeItem(row, col);
+}
 
-            item = new QTableWidgetItem();
-            item->setFlags(item->flags() ^ Qt::ItemIsEditable);
-            item->setIcon(cell);
-            workoutGrid->setItem( row, col++, item );
-        }
-        row++;
-    }
+CalendarWidget::Totals SummaryImpl::dayTotals( const Aggregates::Bucket &day )
+{
+    CalendarWidget::Totals totals;
+    totals.dist = day.dist / day.swims;
+    totals.min_eff = day.min_eff;
+    totals.avg_eff = day.avgEff();
+    totals.max_eff = day.max_eff;
+    return totals;
+}
 
-    std::map<QDate, int>::iterator j;
-    for (j=day_nums.begin(); j!=day_nums.end();++j)
+// Calendar shading of one day after its workouts changed
+void SummaryImpl::updateDay( const QDate &date )
+{
+    const Aggregates::Buckets day = ds->totals(Aggregates::DAY, date, date.addDays(1));
+    if (day.empty())
     {
-        /*        printf("%s - %d %d %d %d\n",
-               qPrintable(j->first.toString("dd/MM")),
-               day_totals[j->first].min_eff,
-               day_totals[j->first].avg_eff,
-               day_totals[j->first].max_eff,
-               j->second);*/
-
-        if (j->second > 1)
-        {
-            day_totals[j->first].avg_eff /= j->second;
-            day_totals[j->first].dist /= j->second;
-        }
+        calendarWidget->setDay(date, 0);
+        return;
     }
+    const CalendarWidget::Totals totals = dayTotals(day.begin()->second);
+    calendarWidget->setDay(date, &totals);
+}
 
-    workoutGrid->selectRow(workoutGrid->rowCount()-1);
-    workoutGrid->resizeColumnsToContents();
-
-    //populate graph
+// Graphs only cover the selected period, redrawn after any change
+void SummaryImpl::updateGraphs()
+{
     setData(ds->Workouts());
-    calendarWidget->setData(day_totals);
+    volumeWidget->update();
+    graphWidget->update();
+    lengthWidget->update();
+}
+
+void SummaryImpl::workoutInserted(int row)
+{
+    const Workout &workout = ds->Workouts()[row];
+    workoutGrid->insertRow(row);
+    fillRow(row, workout);
+    updateDay(startDate(workout.start));
+    updateGraphs();
+}
+
+void SummaryImpl::workoutRemoved(int row)
+{
+    const QTableWidgetItem* it = workoutGrid->item(row, 0);
+    const QDate date = it ? it->data(Qt::DisplayRole).toDate() : QDate();
+    workoutGrid->removeRow(row);
+    updateDay(date);
+    updateGraphs();
+}
+
+void SummaryImpl::workoutModified(int row)
+{
+    const Workout &workout = ds->Workouts()[row];
+    fillRow(row, workout);
+    updateDay(startDate(workout.start));
+
+    // sets and lengths of the one shown
+    if (row == workoutGrid->currentRow())
+        workoutSelected();
+    else
+        updateGraphs();
+}
+
+void SummaryImpl::setModified(int row, int)
+{
+    workoutModified(row);
+}
+
+void SummaryImpl::syncChanged(int row)
+{
+    fillRow(row, ds->Workouts()[row]);
+}
+
+void SummaryImpl::workoutsReset()
+{
+    // Rows move when older years are loaded, keep the same workout
+    // selected and the same one at the top
+    const int selected = selectedId();
+    const QTableWidgetItem* top = workoutGrid->item(workoutGrid->rowAt(0), 0);
+    const int topId = top ? top->data(WORKOUT_ID).toInt() : -1;
+
+    fillWorkouts(ds->Workouts());
+
+    const int row = ds->findWorkout(selected);
+    if (row >= 0)
+        workoutGrid->selectRow(row);
+    const int first = ds->findWorkout(topId);
+    if (first >= 0)
+        workoutGrid->scrollToItem(workoutGrid->item(first, 0), QAbstractItemView::PositionAtTop);
 }
 
 void SummaryImpl::fillLengths( const Workout& wrk)
@@ -370,20 +502,21 @@ void SummaryImpl::fillLengths( const Workout& wrk)
     lengthGrid->setRowCount(wrk.lengths);
 
     const std::vector<Set>& sets = wrk.sets;
+    const LengthTable lengths = wrk.table.decoded();
 
     int set=0;
     int row=0;
     std::vector<Set>::const_iterator it;
     for (it=sets.begin(); it != sets.end(); ++it)
     {
-        if (it->times.size() == 0)
+        if (it->count == 0)
         {
             set++;
             continue;
         }
 
         int i;
-        for (i = 0; i < it->lens; ++i)
+        for (i = 0; i < it->count; ++i)
         {
             uint col=0;
             QTableWidgetItem *item;
@@ -400,14 +533,14 @@ void SummaryImpl::fillLengths( const Workout& wrk)
             item = createTableWidgetItem(QVariant(1 + i));
             lengthGrid->setItem( row, col++, item );
 
-            item = createTableWidgetItem(QVariant(QString::number(it->times[i],'f',3)));
+            item = createTableWidgetItem(QVariant(QString::number(lengths.time(it->first + i) / 1000.0,'f',3)));
             lengthGrid->setItem( row, col++, item );
 
-            item = createTableWidgetItem(QVariant(it->strokes[i]));
+            item = createTableWidgetItem(QVariant(lengths.strokes(it->first + i)));
             lengthGrid->setItem( row, col++, item );
 
-            if ((int)it->styles.size() > i) {
-                item = createTableWidgetItem(QVariant(it->styles[i]));
+            if (lengths.style(it->first + i)) {
+                item = createTableWidgetItem(QVariant(strokeStyles().name(lengths.style(it->first + i))));
                 lengthGrid->setItem( row, col++, item );
             }
             row++;
@@ -419,8 +552,10 @@ void SummaryImpl::fillLengths( const Workout& wrk)
     lengthGrid->setSortingEnabled(true);
 }
 
-void SummaryImpl::fillSets( const std::vector<Set>& sets)
+void SummaryImpl::fillSets( const Workout& wrk)
 {
+    const std::vector<Set>& sets = wrk.sets;
+
     // clearContents() does not reset selected line
     setGrid->setCurrentCell(0,0);
 
@@ -439,7 +574,7 @@ void SummaryImpl::fillSets( const std::vector<Set>& sets)
         item = createTableWidgetItem(QVariant(i->set));
         setGrid->setItem( row, col++, item );
 
-        item = createTableWidgetItem(QVariant(i->duration.toString()));
+        item = createTableWidgetItem(QVariant(msecsToTime(i->duration).toString()));
         setGrid->setItem( row, col++, item );
 
         item = createTableWidgetItem(QVariant(i->lens));
@@ -462,11 +597,11 @@ void SummaryImpl::fillSets( const std::vector<Set>& sets)
 
         col++; // skip stroke
 
-        item = createTableWidgetItem(QVariant(i->rest.toString("mm:ss")));
+        item = createTableWidgetItem(QVariant(msecsToTime(i->rest).toString("mm:ss")));
         setGrid->setItem( row, col++, item );
 
-        QTime actual = getActualSwimTime(*i);
-        QTime duration = i->duration;
+        QTime actual = getActualSwimTime(wrk, *i);
+        QTime duration = msecsToTime(i->duration);
         QString sign("");   // nothign for +
         if (actual > duration)
         {
@@ -511,16 +646,16 @@ void SummaryImpl::workoutSelected()
     // fill sets
     int row = workoutGrid->currentRow();
     QTableWidgetItem* it = workoutGrid->item(row,0);
-    if (it->isSelected())
+    if (it && it->isSelected())
     {
-        if (ds->Workouts().size())
+        const Workout* workout = ds->getWorkout(selectedId());
+        if (workout)
         {
-            const std::vector<Set>& sets = ds->Workouts()[row].sets;
-            fillSets( sets );
+            fillSets( *workout );
 
             //    viewCombo->setCurrentIndex((int)WORKOUTS);
-            calendarWidget->setSelectedDate( ds->Workouts()[row].date );
-            fillLengths(ds->Workouts()[row]);
+            calendarWidget->setSelectedDate( startDate(workout->start) );
+            fillLengths(*workout);
         }
         setData(ds->Workouts());
 
@@ -543,9 +678,6 @@ void SummaryImpl::syncButton()
     UploadImpl win(this);
     win.setDataStore(ds); // will populate our datastore
     win.exec();
-
-    //Repopulate controls
-    fillWorkouts(ds->Workouts());
 }
 
 /* setup path locations and colour preferences */
@@ -555,12 +687,20 @@ void SummaryImpl::configButton()
     win.exec();
 }
 
+// Id of workout on the current row of the workout grid
+int SummaryImpl::selectedId() const
+{
+    const QTableWidgetItem* it = workoutGrid->item(workoutGrid->currentRow(), 0);
+    return it ? it->data(WORKOUT_ID).toInt() : -1;
+}
+
 void SummaryImpl::editButton()
 {
-    int row = workoutGrid->currentRow();
-    if (row >= 0)
+    const int id = selectedId();
+    const Workout* selected = ds->getWorkout(id);
+    if (selected)
     {
-        const Workout & workout = ds->Workouts()[row];
+        const Workout & workout = *selected;
 
         Edit edit(this, workout);
         if (edit.exec() == QDialog::Accepted)
@@ -568,18 +708,16 @@ void SummaryImpl::editButton()
             Workout wrk;
             if ( edit.getModifiedWrk(wrk) )
             {
-                ds->replaceWorkout(row, wrk);
+                ds->replaceWorkout(id, wrk);
+                // follow it if its start moved
+                workoutGrid->selectRow(ds->findWorkout(id));
                 workoutSelected();
             }
         }
         else
         {
             if (edit.isDeleted())
-            {
-                ds->remove(row);
-                //Repopulate controls
-                fillWorkouts(ds->Workouts());
-            }
+                ds->remove(id);
         }
     }
 }
@@ -713,15 +851,17 @@ void SummaryImpl::on_lengthGrid_itemSelectionChanged()
 {
     const QItemSelectionModel *select = lengthGrid->selectionModel();
 
-    if (select->hasSelection())
+    // we know that if there are lengths on the grid
+    // a workout MUST be selected (see workoutSelected())
+    const Workout* current = ds->getWorkout(selectedId());
+
+    if (select->hasSelection() && current)
     {
         const QModelIndexList selected = select->selectedRows();
 
-        // we know that if there are lengths on the grid
-        // a workout MUST be selected (see workoutSelected())
-        const int w_id = workoutGrid->currentRow();
-        const Workout & workout = ds->Workouts()[w_id];
+        const Workout & workout = *current;
         const std::vector<Set>& sets = workout.sets;
+        const LengthTable lengths = workout.table.decoded();
 
         QTime duration(0, 0);
         int n = 0;
@@ -739,7 +879,7 @@ void SummaryImpl::on_lengthGrid_itemSelectionChanged()
 
                 const Set& set = sets[s_id];
 
-                duration = duration.addMSecs(set.times[l_id] * 1000);
+                duration = duration.addMSecs(lengths.time(set.first + l_id));
                 ++n;
             }
         }
@@ -764,7 +904,4 @@ void SummaryImpl::fitButton()
     Export share(this);
     share.setDataStore(ds); // will populate our datastore
     share.exec();
-
-// Overkill repopulate
-    fillWorkouts(ds->Workouts()); //TODO change to gui update
 }
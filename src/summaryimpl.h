@@ -20,6 +20,8 @@
 #define SUMMARYIMPL_H
 //
 #include <QDialog>
+#include <QPixmap>
+#include <QTimer>
 #include "ui_summary.h"
 
 #include "datastore.h"
@@ -46,12 +48,16 @@ public:
     void setData( const Workout& workout );
 
     void fillWorkouts( const std::vector<Workout>& workouts );
-    void fillSets( const std::vector<Set>& sets );
+    void fillRow( int row, const Workout& wrk );
+    void fillSets( const Workout& wrk );
     void fillLengths( const Workout& wrk);
 
     void colorRow(int r, QColor c);
 
-    void setDataStore(DataStore *_ds) { ds = _ds;}
+    void setDataStore(DataStore *_ds);
+
+    // Save changes in the background every minutes, 0 for never
+    void setAutosave(int minutes);
 
  protected:
     void keyPressEvent(QKeyEvent *event);
@@ -68,11 +74,32 @@ public:
     void onCheckClicked(bool);
     void analysisButton();
     void fitButton();
+    void autosave();
+    void calendarPage(int year, int month);
+
+    // DataStore changes
+    void workoutInserted(int row);
+    void workoutRemoved(int row);
+    void workoutModified(int row);
+    void setModified(int row, int set);
+    void syncChanged(int row);
+    void workoutsReset();
 
 private:
     void on_lengthGrid_itemSelectionChanged();
+    int selectedId() const;
+    QString axisLabel( const QDate &date ) const;
+    static CalendarWidget::Totals dayTotals( const Aggregates::Bucket &day );
+    void updateDay( const QDate &date );
+    void updateGraphs();
 
     DataStore *ds;
     Scale scale;
+    QTimer autosaveTimer;
+
+    // sync status icons
+    QPixmap garmin;
+    QPixmap strava;
+    QPixmap tick;
 };
 #endif
@@ -17,6 +17,7 @@
  */
 
 #include <QFileDialog>
+#include <QMultiHash>
 
 #include <stdio.h>
 #include "uploadimpl.h"
@@ -38,38 +39,73 @@ UploadImpl::UploadImpl( QWidget * parent, Qt::WindowFlags f)
 
 void UploadImpl::fillList()
 {
-    std::vector<ExerciseSet>::iterator i;
-    
-    int pos=0;
-    QDateTime run;
-    for (i=exdata.begin(); i!= exdata.end(); ++i, ++pos)
+    // copies earlier in this batch, a multi-year export can repeat itself
+    QMultiHash<quint64, qint64> seen;
+
+    // stored workouts back to the oldest session, read in one go
+    if (!exdata.empty())
     {
-        if (run != QDateTime(i->date,i->time))
-        {
-            run = QDateTime(i->date,i->time);
-            
-            // TODO replace this with custom drawn control
-            QString line = QString("[%1] \t%2")
-                    .arg(run.toString("yyyy/MM/dd hh:mm"))
-                    .arg(i->lengths);
-            
-            QListWidgetItem* i = new QListWidgetItem(line);
-            i->setData(Qt::UserRole, pos);
+        qint64 oldest = exdata.front().start;
+        for (size_t e = 1; e < exdata.size(); ++e)
+            oldest = qMin(oldest, exdata[e].start);
+        ds->loadFrom(startDate(oldest));
+    }
 
-            // if set already uploaded, check and disable
-            if (ds->findExercise(run) >= 0)
+    size_t pos=0;
+    while (pos < exdata.size())
+    {
+        const qint64 run = exdata[pos].start;
+        size_t end = pos + 1;
+        while (end < exdata.size() && exdata[end].start == run)
+            ++end;
+
+        // TODO replace this with custom drawn control
+        QString line = QString("[%1] \t%2")
+                .arg(startDateTime(run).toString("yyyy/MM/dd hh:mm"))
+                .arg(exdata[pos].lengths);
+
+        QListWidgetItem* i = new QListWidgetItem(line);
+        i->setData(Qt::UserRole, (int)pos);
+
+        const quint64 print = DataStore::fingerprint(exdata.data() + pos, exdata.data() + end);
+        bool lengths = false;
+        for (size_t e = pos; e < end; ++e)
+            lengths = lengths || !exdata[e].len_time.empty();
+
+        DataStore::Match match = ds->isImported(run, print, lengths);
+        if (print && match != DataStore::STORED)
+        {
+            QMultiHash<quint64, qint64>::const_iterator s;
+            for (s = seen.constFind(print); s != seen.constEnd() && s.key() == print; ++s)
             {
-                //                i->setFlags(Qt::ItemIsSelectable|Qt::ItemIsEnabled);
-                i->setFlags(0);
-                i->setCheckState(Qt::Checked);
+                if (DataStore::nearStart(run, s.value()))
+                    match = lengths ? DataStore::STORED : DataStore::SIMILAR;
             }
-            else
+        }
+
+        // if set already uploaded, check and disable
+        if (match == DataStore::STORED)
+        {
+            //                i->setFlags(Qt::ItemIsSelectable|Qt::ItemIsEnabled);
+            i->setFlags(0);
+            i->setCheckState(Qt::Checked);
+        }
+        else
+        {
+            // could be a copy, left for the user to decide
+            if (match == DataStore::SIMILAR)
             {
-                i->setFlags(Qt::ItemIsUserCheckable|Qt::ItemIsEnabled);
-                i->setCheckState(Qt::Unchecked);
+                i->setText(line + tr(" \t(possible copy)"));
+                i->setToolTip(tr("The same sets as a workout within a day of this one, "
+                                 "without lengths to tell them apart."));
             }
-            listWidget->addItem(i);
+            i->setFlags(Qt::ItemIsUserCheckable|Qt::ItemIsEnabled);
+            i->setCheckState(Qt::Unchecked);
         }
+        listWidget->addItem(i);
+
+        seen.insert(print, run);
+        pos = end;
     }
 }
 
@@ -185,11 +221,11 @@ void UploadImpl::add()
             i->setCheckState(Qt::Checked);
             
             // TODO add session ids to remove this date grouping hack.
-            QDateTime initial(exdata[pos].date, exdata[pos].time);
+            const qint64 initial = exdata[pos].start;
 
             std::vector<ExerciseSet> sets;
             while (pos < exdata.size() &&
-                   QDateTime(exdata[pos].date, exdata[pos].time) == initial)
+                   exdata[pos].start == initial)
             {
                 sets.push_back(exdata[pos++]);
             }
@@ -27,6 +27,7 @@
 const int SET_ID            = Qt::UserRole + 1;
 const int LENGTH_ID         = Qt::UserRole + 2;
 const int NEW_BEST_TIME     = Qt::UserRole + 3;
+const int WORKOUT_ID        = Qt::UserRole + 4;
 
 QTableWidgetItem * createTableWidgetItem(const QVariant & content)
 {
@@ -39,15 +40,16 @@ QTableWidgetItem * createTableWidgetItem(const QVariant & content)
 }
 
 // sums the duration of all the lanes
-QTime getActualSwimTime(const Set & set)
+QTime getActualSwimTime(const Workout & workout, const Set & set)
 {
-    QTime duration(0, 0);
+    const LengthTable lengths = workout.table.decoded();
+    int msecs = 0;
 
-    for (size_t i = 0; i < set.times.size(); ++i)
+    for (int i = 0; i < set.count; ++i)
     {
-        duration = duration.addMSecs(set.times[i] * 1000);
+        msecs += lengths.time(set.first + i);
     }
-    return duration;
+    return QTime(0, 0).addMSecs(msecs);
 }
 
 // mimic watch that rounds to 8th of a second
@@ -63,40 +65,41 @@ void synchroniseWorkout(Workout & workout)
     const size_t numberOfSets = workout.sets.size();
 
     int lengths = 0;
-    QTime rest;
-    QTime totalDuration(0, 0);
+    int rest = -1;
+    int totalDuration = 0;
     for (size_t i = 0; i < numberOfSets; ++i)
     {
         const Set & set = workout.sets[i];
         lengths += set.lens;
-        if (rest.isValid())
+        // sums wrap at a day as QTime did, the csv file has no room for more
+        if (rest >= 0)
         {
-            rest = rest.addMSecs(set.rest.msecsSinceStartOfDay());
+            rest = (rest + qMax(set.rest, 0)) % 86400000;
         }
         else
         {
             // if the sets do not have rest
             // we keep the existing rest on the workout
             // (see end of setsToWorkouts() in datastore.cpp)
-            if (set.rest.isValid())
+            if (set.rest >= 0)
             {
                 rest = set.rest;
             }
         }
-        totalDuration = totalDuration.addMSecs(set.duration.msecsSinceStartOfDay());
+        totalDuration = (totalDuration + qMax(set.duration, 0)) % 86400000;
     }
 
     // always update lenghts and total
     workout.lengths = lengths;
     workout.totaldistance = lengths * workout.pool;
 
-    if (rest.isValid())
+    if (rest >= 0)
     {
         workout.rest = rest;
         // otherwise leave it unchanged
     }
 
     // use the actual rest to compute total duration
-    totalDuration = totalDuration.addMSecs(workout.rest.msecsSinceStartOfDay());
+    totalDuration = (totalDuration + qMax(workout.rest, 0)) % 86400000;
     workout.totalduration = totalDuration;
 }
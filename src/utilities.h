@@ -30,12 +30,13 @@ struct Workout;
 extern const int SET_ID;
 extern const int LENGTH_ID;
 extern const int NEW_BEST_TIME;
+extern const int WORKOUT_ID;
 
 // ReadOnly, horizontal Right aligned, non editable
 QTableWidgetItem * createTableWidgetItem(const QVariant & content);
 
 // sums the duration of all the lanes
-QTime getActualSwimTime(const Set & set);
+QTime getActualSwimTime(const Workout & workout, const Set & set);
 
 // mimic watch that rounds to 8th of a second
 double roundTo8thSecond(double value);
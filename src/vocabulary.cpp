@@ -0,0 +1,86 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <limits>
+
+#include "vocabulary.h"
+
+Vocabulary::Vocabulary(const char *const *predefined)
+    : names(1)
+{
+    for (; predefined && *predefined; ++predefined)
+        code(QString::fromLatin1(*predefined));
+}
+
+int Vocabulary::code(const QString &name)
+{
+    if (name.isEmpty())
+        return 0;
+
+    QMutexLocker locker(&lock);
+    QHash<QString, int>::const_iterator i = codes.constFind(name);
+    if (i != codes.constEnd())
+        return i.value();
+
+    // codes are stored in 16 bits
+    if (names.size() > std::numeric_limits<quint16>::max())
+        return 0;
+
+    const int id = names.size();
+    names.push_back(name);
+    codes.insert(name, id);
+    return id;
+}
+
+int Vocabulary::find(const QString &name) const
+{
+    if (name.isEmpty())
+        return 0;
+
+    QMutexLocker locker(&lock);
+    return codes.value(name, -1);
+}
+
+QString Vocabulary::name(int code) const
+{
+    QMutexLocker locker(&lock);
+    return code > 0 && code < (int)names.size() ? names[code] : QString();
+}
+
+namespace {
+// in WorkoutType order
+const char *const type_names[] = { "Swim", "SwimHR", "Chrono", 0 };
+} //namespace
+
+Vocabulary &workoutTypes()
+{
+    static Vocabulary types(type_names);
+    return types;
+}
+
+Vocabulary &poolUnits()
+{
+    static Vocabulary units;
+    return units;
+}
+
+Vocabulary &strokeStyles()
+{
+    static Vocabulary styles;
+    return styles;
+}
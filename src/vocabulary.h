@@ -0,0 +1,67 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VOCABULARY_H
+#define VOCABULARY_H
+
+#include <vector>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+/*
+ * Interned names with small integer codes.
+ *
+ * Workout types, pool units and stroke styles come from a handful of
+ * distinct strings, workouts hold the code instead. Code 0 is always
+ * the empty string and codes never change once given out.
+ */
+class Vocabulary
+{
+public:
+    // Names given codes 1..n in order
+    explicit Vocabulary(const char *const *names = 0);
+
+    // Code for name, added if new. 0 for empty or if the table is full.
+    int code(const QString &name);
+
+    // -1 if name has no code
+    int find(const QString &name) const;
+
+    QString name(int code) const;
+
+private:
+    mutable QMutex lock;
+    std::vector<QString> names;
+    QHash<QString, int> codes;
+};
+
+// Fixed codes of workout types, other types are added as seen
+enum WorkoutType
+{
+    TYPE_NONE = 0,
+    TYPE_SWIM,
+    TYPE_SWIMHR,
+    TYPE_CHRONO
+};
+
+Vocabulary &workoutTypes();
+Vocabulary &poolUnits();
+Vocabulary &strokeStyles();
+
+#endif
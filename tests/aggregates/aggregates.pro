@@ -0,0 +1,5 @@
+TARGET = tst_aggregates
+
+include(../tests.pri)
+
+SOURCES += tst_aggregates.cpp
@@ -0,0 +1,192 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "aggregates.h"
+#include "datastore.h"
+#include "testdata.h"
+
+namespace {
+bool sameBucket(const Aggregates::Bucket &a, const Aggregates::Bucket &b)
+{
+    return a.swims == b.swims && a.dist == b.dist && a.duration == b.duration &&
+            a.rest == b.rest && a.cal == b.cal && a.min_eff == b.min_eff &&
+            a.max_eff == b.max_eff && a.sum_eff == b.sum_eff;
+}
+
+// Kept totals match counting every workout again
+bool counted(DataStore &ds)
+{
+    Aggregates fresh;
+    fresh.reset(ds.Workouts());
+    for (int p = 0; p < Aggregates::PERIODS; ++p)
+    {
+        const Aggregates::Period period = Aggregates::Period(p);
+        const Aggregates::Buckets kept = ds.totals(period, QDate(), QDate());
+        const Aggregates::Buckets all = fresh.range(period, QDate(), QDate(), ds.Workouts());
+        if (kept.size() != all.size())
+            return false;
+
+        Aggregates::Buckets::const_iterator k, a;
+        for (k = kept.begin(), a = all.begin(); k != kept.end(); ++k, ++a)
+        {
+            if (k->first != a->first || !sameBucket(k->second, a->second))
+                return false;
+        }
+    }
+    return true;
+}
+
+Workout swim(const QDate &date, int hour, int eff)
+{
+    Workout w;
+    w.start = toStart(date, QTime(hour, 0));
+    w.type = TYPE_SWIM;
+    w.totalduration = 600000;
+    w.rest = 60000;
+    w.cal = 100;
+    w.totaldistance = 500;
+    w.min_eff = w.avg_eff = w.max_eff = eff;
+    return w;
+}
+} //namespace
+
+class TestAggregates : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void periods();
+    void keptInStep();
+    void staleRecount();
+
+private:
+    QString csvFile() const { return dir->filePath("data.csv"); }
+
+    QScopedPointer<QTemporaryDir> dir;
+};
+
+void TestAggregates::init()
+{
+    dir.reset(new QTemporaryDir);
+    QVERIFY(dir->isValid());
+    QVERIFY(writeFile(csvFile(), sampleCopies(QDate(2009, 12, 1), 20)));
+}
+
+void TestAggregates::periods()
+{
+    // a sunday, the monday after and the first of the next month
+    Aggregates totals;
+    totals.add(swim(QDate(2010, 1, 31), 7, 40));
+    totals.add(swim(QDate(2010, 2, 1), 7, 50));
+    totals.add(swim(QDate(2010, 2, 1), 18, 60));
+
+    std::vector<Workout> rows;
+    Aggregates::Buckets days = totals.range(Aggregates::DAY, QDate(), QDate(), rows);
+    QCOMPARE(days.size(), size_t(2));
+    QCOMPARE(days[QDate(2010, 2, 1)].swims, 2);
+    QCOMPARE(days[QDate(2010, 2, 1)].dist, 1000);
+    QCOMPARE(days[QDate(2010, 2, 1)].duration, qint64(1200000));
+    QCOMPARE(days[QDate(2010, 2, 1)].avgEff(), 55);
+
+    Aggregates::Buckets weeks = totals.range(Aggregates::WEEK, QDate(), QDate(), rows);
+    QCOMPARE(weeks.size(), size_t(2));
+    QCOMPARE(weeks[QDate(2010, 1, 25)].swims, 1);
+    QCOMPARE(weeks[QDate(2010, 2, 1)].swims, 2);
+
+    Aggregates::Buckets months = totals.range(Aggregates::MONTH, QDate(2010, 2, 1), QDate(), rows);
+    QCOMPARE(months.size(), size_t(1));
+    QCOMPARE(months.begin()->second.min_eff, 50);
+    QCOMPARE(months.begin()->second.max_eff, 60);
+}
+
+void TestAggregates::keptInStep()
+{
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+    QVERIFY(counted(ds));
+
+    std::vector<ExerciseSet> session = readSessions(csvFile())[4];
+    for (size_t s = 0; s < session.size(); ++s)
+        session[s].start += 3600;
+    QVERIFY(ds.add(session) > 0);
+    QVERIFY(counted(ds));
+
+    ds.remove(ds.Workouts()[7].id);
+    QVERIFY(counted(ds));
+
+    Workout changed = ds.Workouts()[3];
+    changed.cal += 50;
+    changed.totaldistance += 100;
+    changed.max_eff += 10;
+    ds.replaceWorkout(changed.id, changed);
+    QVERIFY(counted(ds));
+
+    ds.removeSet(ds.Workouts()[10].id, 0);
+    QVERIFY(counted(ds));
+
+    ds.remove(startDateTime(ds.Workouts()[12].start));
+    QVERIFY(counted(ds));
+
+    WorkoutQuery december;
+    december.to = toStart(QDate(2010, 1, 1), QTime(0, 0));
+    QVERIFY(ds.remove(december) > 0);
+    QVERIFY(counted(ds));
+}
+
+void TestAggregates::staleRecount()
+{
+    std::vector<Workout> rows;
+    rows.push_back(swim(QDate(2010, 2, 1), 7, 40));
+    rows.push_back(swim(QDate(2010, 2, 1), 12, 50));
+    rows.push_back(swim(QDate(2010, 2, 1), 18, 60));
+
+    Aggregates totals;
+    totals.reset(rows);
+
+    // the lowest and highest can't be taken back out
+    totals.remove(rows[0]);
+    totals.remove(rows[2]);
+    rows.erase(rows.begin() + 2);
+    rows.erase(rows.begin());
+
+    for (int p = 0; p < Aggregates::PERIODS; ++p)
+    {
+        const Aggregates::Buckets found = totals.range(Aggregates::Period(p), QDate(), QDate(), rows);
+        QCOMPARE(found.size(), size_t(1));
+        const Aggregates::Bucket &b = found.begin()->second;
+        QVERIFY(!b.stale);
+        QCOMPARE(b.swims, 1);
+        QCOMPARE(b.min_eff, 50);
+        QCOMPARE(b.max_eff, 50);
+        QCOMPARE(b.dist, 500);
+    }
+
+    // the last one out drops the period
+    totals.remove(rows[0]);
+    rows.clear();
+    QVERIFY(totals.range(Aggregates::DAY, QDate(), QDate(), rows).empty());
+}
+
+QTEST_GUILESS_MAIN(TestAggregates)
+#include "tst_aggregates.moc"
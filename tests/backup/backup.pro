@@ -0,0 +1,5 @@
+TARGET = tst_backup
+
+include(../tests.pri)
+
+SOURCES += tst_backup.cpp
@@ -0,0 +1,200 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QDir>
+#include <QSet>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "backup.h"
+#include "binstore.h"
+#include "datastore.h"
+#include "testdata.h"
+
+namespace {
+// Bytes that don't repeat, so only the cuts chosen by content match up
+QByteArray noise(int size, quint32 seed)
+{
+    QByteArray data(size, 0);
+    quint32 x = seed;
+    for (int i = 0; i < size; ++i)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        data[i] = (char)(x >> 24);
+    }
+    return data;
+}
+
+QByteArray readFile(const QString &name)
+{
+    QFile file(name);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readAll();
+}
+} //namespace
+
+class TestBackup : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void chunking();
+    void pruning();
+    void restore();
+    void storeBackups();
+
+private:
+    QString file() const { return dir->filePath("data.pvd"); }
+    QString backups() const { return dir->filePath("data.pvd.backups"); }
+    int chunks() const { return QDir(backups() + "/chunks").entryList(QDir::Files).size(); }
+
+    // Back up data as the file, a moment after the last so names differ
+    bool backUp(const QByteArray &data, int keep);
+
+    QScopedPointer<QTemporaryDir> dir;
+};
+
+void TestBackup::init()
+{
+    dir.reset(new QTemporaryDir);
+    QVERIFY(dir->isValid());
+}
+
+bool TestBackup::backUp(const QByteArray &data, int keep)
+{
+    QTest::qSleep(5);
+    return writeFile(file(), data) && BackupFile(file(), backups(), keep);
+}
+
+void TestBackup::chunking()
+{
+    const QByteArray first = noise(256*1024, 1);
+    QVERIFY(backUp(first, 10));
+    const int written = chunks();
+    QVERIFY(written > 4);
+
+    // the same again adds nothing
+    QVERIFY(backUp(first, 10));
+    QCOMPARE(chunks(), written);
+
+    // an insert only changes the chunks around it
+    QByteArray second = first;
+    second.insert(100*1024, noise(100, 2));
+    QVERIFY(backUp(second, 10));
+    QVERIFY(chunks() > written);
+    QVERIFY(chunks() <= written + 2);
+
+    const QStringList names = ListBackups(backups());
+    QCOMPARE(names.size(), 3);
+    QVERIFY(RestoreBackup(backups(), names[0], dir->filePath("first")));
+    QCOMPARE(readFile(dir->filePath("first")), first);
+    QVERIFY(RestoreBackup(backups(), names[2], dir->filePath("second")));
+    QCOMPARE(readFile(dir->filePath("second")), second);
+}
+
+void TestBackup::pruning()
+{
+    QList<QByteArray> versions;
+    for (int v = 0; v < 4; ++v)
+    {
+        versions << noise(64*1024, v + 1);
+        QVERIFY(backUp(versions.last(), 2));
+    }
+
+    // the newest two, chunks of the others gone
+    const QStringList names = ListBackups(backups());
+    QCOMPARE(names.size(), 2);
+    QVERIFY(LastBackup(backups()).isValid());
+
+    QSet<QByteArray> used;
+    for (int n = 0; n < names.size(); ++n)
+    {
+        const QList<QByteArray> lines = readFile(backups() + "/" + names[n]).split('\n');
+        for (int l = 1; l < lines.size(); ++l)
+        {
+            if (!lines[l].isEmpty())
+                used.insert(lines[l].left(lines[l].indexOf(' ')));
+        }
+    }
+    QCOMPARE(chunks(), used.size());
+
+    for (int n = 0; n < names.size(); ++n)
+    {
+        QVERIFY(RestoreBackup(backups(), names[n], dir->filePath("restored")));
+        QCOMPARE(readFile(dir->filePath("restored")), versions[n + 2]);
+    }
+}
+
+void TestBackup::restore()
+{
+    const QByteArray data = noise(32*1024, 3);
+    QVERIFY(backUp(data, 10));
+    const QString name = ListBackups(backups()).last();
+
+    // the file is replaced whole
+    QVERIFY(writeFile(dir->filePath("restored"), "something else"));
+    QVERIFY(RestoreBackup(backups(), name, dir->filePath("restored")));
+    QCOMPARE(readFile(dir->filePath("restored")), data);
+
+    // a damaged chunk fails rather than give back something else
+    const QStringList stored = QDir(backups() + "/chunks").entryList(QDir::Files);
+    QVERIFY(writeFile(backups() + "/chunks/" + stored[0], qCompress(QByteArray("damaged"))));
+    QVERIFY(writeFile(dir->filePath("restored"), "kept"));
+    QVERIFY(!RestoreBackup(backups(), name, dir->filePath("restored")));
+    QCOMPARE(readFile(dir->filePath("restored")), QByteArray("kept"));
+
+    QVERIFY(!RestoreBackup(backups(), "backup-missing", dir->filePath("restored")));
+}
+
+void TestBackup::storeBackups()
+{
+    const QString csv = dir->filePath("data.csv");
+    QVERIFY(writeFile(csv, sample_csv));
+
+    std::vector<Workout> first;
+    {
+        DataStore ds;
+        ds.setFile(csv);
+        ds.setBackup(true);
+        QVERIFY(ds.load());
+        QVERIFY(ds.save());
+        first = ds.Workouts();
+
+        // each save backs up the year it replaces
+        ds.remove(ds.Workouts()[0].id);
+        ds.setChanged();
+        QVERIFY(ds.save());
+    }
+
+    const QString year = dir->filePath("data-2010.pvd.backups");
+    const QStringList names = ListBackups(year);
+    QCOMPARE(names.size(), 1);
+    QVERIFY(RestoreBackup(year, names[0], dir->filePath("restored.pvd")));
+
+    std::vector<Workout> restored;
+    QVERIFY(ReadStore(dir->filePath("restored.pvd"), restored));
+    QVERIFY(sameWorkouts(restored, first));
+}
+
+QTEST_GUILESS_MAIN(TestBackup)
+#include "tst_backup.moc"
@@ -0,0 +1,5 @@
+TARGET = tst_binstore
+
+include(../tests.pri)
+
+SOURCES += tst_binstore.cpp
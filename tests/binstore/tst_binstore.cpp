@@ -0,0 +1,73 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "binstore.h"
+#include "datastore.h"
+#include "testdata.h"
+
+class TestBinStore : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void roundTrip();
+
+private:
+    QString csvFile() const { return dir->filePath("data.csv"); }
+
+    QScopedPointer<QTemporaryDir> dir;
+};
+
+void TestBinStore::init()
+{
+    dir.reset(new QTemporaryDir);
+    QVERIFY(dir->isValid());
+    QVERIFY(writeFile(csvFile(), sample_csv));
+}
+
+void TestBinStore::roundTrip()
+{
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+    QCOMPARE(ds.Workouts().size(), size_t(3));
+    QCOMPARE(ds.Workouts()[0].table.size(), 0);
+    QCOMPARE(ds.Workouts()[1].table.size(), 6);
+
+    const QString name = dir->filePath("round.pvd");
+    QVERIFY(SaveStore(name, ds.Workouts(), 42));
+
+    std::vector<Workout> read;
+    quint64 sequence = 0;
+    QVERIFY(ReadStore(name, read, &sequence));
+    QCOMPARE(sequence, quint64(42));
+    QVERIFY(sameWorkouts(ds.Workouts(), read));
+
+    // lengths left in the file until used
+    std::vector<Workout> lazy;
+    QVERIFY(ReadStore(name, lazy, 0, true));
+    QVERIFY(sameWorkouts(ds.Workouts(), lazy));
+}
+
+QTEST_GUILESS_MAIN(TestBinStore)
+#include "tst_binstore.moc"
@@ -0,0 +1,5 @@
+TARGET = tst_csv
+
+include(../tests.pri)
+
+SOURCES += tst_csv.cpp
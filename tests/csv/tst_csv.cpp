@@ -0,0 +1,111 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "datastore.h"
+#include "testdata.h"
+
+class TestCsv : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void roundTrip();
+    void parallelRead();
+    void goldenFile();
+
+private:
+    QString csvFile() const { return dir->filePath("data.csv"); }
+
+    QScopedPointer<QTemporaryDir> dir;
+};
+
+void TestCsv::init()
+{
+    dir.reset(new QTemporaryDir);
+    QVERIFY(dir->isValid());
+    QVERIFY(writeFile(csvFile(), sample_csv));
+}
+
+void TestCsv::roundTrip()
+{
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+
+    const QString copy = dir->filePath("copy.csv");
+    QVERIFY(ds.exportCSV(copy));
+
+    DataStore read;
+    read.setFile(copy);
+    QVERIFY(read.load());
+    QVERIFY(sameWorkouts(ds.Workouts(), read.Workouts(), false));
+}
+
+void TestCsv::parallelRead()
+{
+    // big enough to be split across four threads
+    const QString big = dir->filePath("big.csv");
+    QVERIFY(writeFile(big, sampleCopies(QDate(2001, 1, 1), 2000)));
+
+    std::vector<Workout> single, parallel;
+    QVERIFY(ReadCSV(big.toStdString(), single, 1));
+    QVERIFY(ReadCSV(big.toStdString(), parallel, 4));
+    QCOMPARE(single.size(), size_t(6000));
+    QVERIFY(sameWorkouts(single, parallel));
+
+    std::vector<ExerciseSet> rows, parallelRows;
+    QVERIFY(ReadCSV(big.toStdString(), rows, 1));
+    QVERIFY(ReadCSV(big.toStdString(), parallelRows, 4));
+    QCOMPARE(parallelRows.size(), rows.size());
+    for (size_t r = 0; r < rows.size(); ++r)
+    {
+        QCOMPARE(parallelRows[r].start, rows[r].start);
+        QCOMPARE(parallelRows[r].set, rows[r].set);
+        QCOMPARE(parallelRows[r].duration, rows[r].duration);
+        QVERIFY(parallelRows[r].len_time == rows[r].len_time);
+        QVERIFY(parallelRows[r].len_strokes == rows[r].len_strokes);
+    }
+}
+
+void TestCsv::goldenFile()
+{
+    // golden.csv is what the QTextStream writer made of sample.csv
+    const QString sample = dir->filePath("sample.csv");
+    QVERIFY(QFile::copy(QFINDTESTDATA("data/sample.csv"), sample));
+
+    DataStore ds;
+    ds.setFile(sample);
+    QVERIFY(ds.load());
+
+    const QString written = dir->filePath("written.csv");
+    QVERIFY(ds.exportCSV(written));
+
+    QFile golden(QFINDTESTDATA("data/golden.csv"));
+    QFile out(written);
+    QVERIFY(golden.open(QIODevice::ReadOnly|QIODevice::Text));
+    QVERIFY(out.open(QIODevice::ReadOnly|QIODevice::Text));
+    QCOMPARE(out.readAll(), golden.readAll());
+}
+
+QTEST_GUILESS_MAIN(TestCsv)
+#include "tst_csv.moc"
@@ -0,0 +1,5 @@
+TARGET = tst_fingerprint
+
+include(../tests.pri)
+
+SOURCES += tst_fingerprint.cpp
@@ -0,0 +1,114 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "datastore.h"
+#include "testdata.h"
+
+class TestFingerprint : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void matches();
+    void differs();
+
+private:
+    QString csvFile() const { return dir->filePath("data.csv"); }
+
+    QScopedPointer<QTemporaryDir> dir;
+};
+
+void TestFingerprint::init()
+{
+    dir.reset(new QTemporaryDir);
+    QVERIFY(dir->isValid());
+    QVERIFY(writeFile(csvFile(), sample_csv));
+}
+
+void TestFingerprint::matches()
+{
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+
+    const std::vector<std::vector<ExerciseSet> > sessions = readSessions(csvFile());
+    QCOMPARE(sessions.size(), ds.Workouts().size());
+
+    for (size_t row = 0; row < sessions.size(); ++row)
+    {
+        const Workout &workout = ds.Workouts()[row];
+        const std::vector<ExerciseSet> &session = sessions[row];
+        const quint64 print = DataStore::fingerprint(session.data(), session.data() + session.size());
+        QVERIFY(print != 0);
+        QCOMPARE(print, DataStore::fingerprint(workout));
+        QCOMPARE(ds.isImported(workout.start, print, true), DataStore::STORED);
+
+        // the watch clock an hour out, sure only when there are lengths
+        const bool lengths = workout.table.size() > 0;
+        QCOMPARE(ds.isImported(workout.start + 3600, print, lengths),
+                 lengths ? DataStore::STORED : DataStore::SIMILAR);
+
+        // the same sets swum again days later
+        QCOMPARE(ds.isImported(workout.start + 3*24*3600, print, lengths), DataStore::NOT_STORED);
+    }
+
+    // lengths of a removed set don't count
+    Workout removed = ds.Workouts()[1];
+    removed.removeSet(0);
+    Workout orphaned = ds.Workouts()[1];
+    orphaned.sets.erase(orphaned.sets.begin());
+    QCOMPARE(DataStore::fingerprint(removed), DataStore::fingerprint(orphaned));
+}
+
+void TestFingerprint::differs()
+{
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+
+    const Workout workout = ds.Workouts()[1];
+    const quint64 print = DataStore::fingerprint(workout);
+
+    Workout other = workout;
+    other.type = workout.type == TYPE_SWIM ? TYPE_SWIMHR : TYPE_SWIM;
+    QVERIFY(DataStore::fingerprint(other) != print);
+
+    other = workout;
+    other.sets[0].duration += 1000;
+    QVERIFY(DataStore::fingerprint(other) != print);
+
+    other = workout;
+    other.addLength(1, 40000, 12, 0);
+    QVERIFY(DataStore::fingerprint(other) != print);
+
+    QVERIFY(DataStore::fingerprint(ds.Workouts()[0]) != print);
+    QVERIFY(DataStore::fingerprint(ds.Workouts()[2]) != print);
+    QCOMPARE(DataStore::fingerprint(Workout()), quint64(0));
+
+    // not stored once removed
+    ds.remove(workout.id);
+    QCOMPARE(ds.isImported(workout.start + 3600, print, true), DataStore::NOT_STORED);
+}
+
+QTEST_GUILESS_MAIN(TestFingerprint)
+#include "tst_fingerprint.moc"
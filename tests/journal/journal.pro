@@ -0,0 +1,5 @@
+TARGET = tst_journal
+
+include(../tests.pri)
+
+SOURCES += tst_journal.cpp
@@ -0,0 +1,219 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "datastore.h"
+#include "testdata.h"
+
+class TestJournal : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void replay();
+    void truncatedTail();
+    void compactOnSave();
+    void compactWhenLarge();
+    void otherFormat();
+
+private:
+    QString csvFile() const { return dir->filePath("data.csv"); }
+    QString journalFile() const { return dir->filePath("data.pvd.journal"); }
+
+    QScopedPointer<QTemporaryDir> dir;
+};
+
+void TestJournal::init()
+{
+    dir.reset(new QTemporaryDir);
+    QVERIFY(dir->isValid());
+    QVERIFY(writeFile(csvFile(), sample_csv));
+}
+
+void TestJournal::replay()
+{
+    std::vector<Workout> expected;
+    {
+        DataStore ds;
+        ds.setFile(csvFile());
+        QVERIFY(ds.load());
+        QVERIFY(ds.save());
+
+        // each change goes to the journal, nothing is saved after
+        Workout changed = ds.Workouts()[1];
+        changed.addLength(0, 38250, 11, 0);
+        ds.replaceWorkout(changed.id, changed);
+        ds.removeSet(ds.Workouts()[2].id, 0);
+        ds.remove(ds.Workouts()[0].id);
+        QVERIFY(ds.add(readSessions(csvFile())[1]) > 0);
+        expected = ds.Workouts();
+    }
+    QVERIFY(QFile(journalFile()).size() > 8);
+
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+    QVERIFY(sameWorkouts(ds.Workouts(), expected));
+}
+
+void TestJournal::truncatedTail()
+{
+    std::vector<Workout> expected;
+    {
+        DataStore ds;
+        ds.setFile(csvFile());
+        QVERIFY(ds.load());
+        QVERIFY(ds.save());
+
+        ds.remove(ds.Workouts()[0].id);
+        expected = ds.Workouts();
+
+        Workout changed = ds.Workouts()[0];
+        changed.pool = 50;
+        ds.replaceWorkout(changed.id, changed);
+    }
+
+    // the last entry cut short, as by a crash part way through writing it
+    QFile file(journalFile());
+    QVERIFY(file.resize(file.size() - 3));
+
+    {
+        DataStore ds;
+        ds.setFile(csvFile());
+        QVERIFY(ds.load());
+        QVERIFY(ds.loadError().isEmpty());
+        QVERIFY(sameWorkouts(ds.Workouts(), expected));
+
+        // the torn entry is dropped, later changes follow on from the rest
+        ds.remove(ds.Workouts()[0].id);
+        expected = ds.Workouts();
+    }
+
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+    QVERIFY(sameWorkouts(ds.Workouts(), expected));
+}
+
+void TestJournal::compactOnSave()
+{
+    std::vector<Workout> expected;
+    {
+        DataStore ds;
+        ds.setFile(csvFile());
+        QVERIFY(ds.load());
+        QVERIFY(ds.save());
+
+        ds.remove(ds.Workouts()[0].id);
+        Workout changed = ds.Workouts()[0];
+        changed.pool = 50;
+        ds.replaceWorkout(changed.id, changed);
+        QVERIFY(QFile(journalFile()).size() > 8);
+
+        // written in full, the journal is folded into the data files
+        ds.setChanged();
+        QVERIFY(ds.save());
+        QCOMPARE(QFile(journalFile()).size(), qint64(8));
+        expected = ds.Workouts();
+
+        // numbering carries on after the entries dropped
+        ds.remove(ds.Workouts()[1].id);
+        expected.erase(expected.begin() + 1);
+    }
+
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+    QVERIFY(sameWorkouts(ds.Workouts(), expected));
+}
+
+void TestJournal::compactWhenLarge()
+{
+    std::vector<Workout> expected;
+    std::vector<ExerciseSet> session = readSessions(csvFile())[1];
+    {
+        DataStore ds;
+        ds.setFile(csvFile());
+        QVERIFY(ds.load());
+        QVERIFY(ds.save());
+
+        // a day apart, until the journal is big enough to fold in
+        for (int day = 1; day <= 1000; ++day)
+        {
+            for (size_t s = 0; s < session.size(); ++s)
+                session[s].start += 86400;
+            QVERIFY(ds.add(session) > 0);
+        }
+        expected = ds.Workouts();
+    }
+    QVERIFY(QFile(journalFile()).size() < 256*1024);
+    QVERIFY(QFile::exists(dir->filePath("data-2012.pvd")));
+
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+    QVERIFY(ds.loadAll());
+    QVERIFY(sameWorkouts(ds.Workouts(), expected));
+}
+
+void TestJournal::otherFormat()
+{
+    std::vector<Workout> expected;
+    {
+        DataStore ds;
+        ds.setFile(csvFile());
+        QVERIFY(ds.load());
+        QVERIFY(ds.save());
+        expected = ds.Workouts();
+    }
+
+    // as written by a later version, its entries may not be in the data files
+    QByteArray other("PVDJ\x63\0\0\0", 8);
+    other.append("entries not understood");
+    QVERIFY(writeFile(journalFile(), other));
+
+    {
+        DataStore ds;
+        ds.setFile(csvFile());
+        QVERIFY(ds.load());
+        QVERIFY(!ds.loadError().isEmpty());
+        QVERIFY(sameWorkouts(ds.Workouts(), expected));
+
+        // saved to the data files in full instead
+        ds.remove(ds.Workouts()[0].id);
+        expected = ds.Workouts();
+        QVERIFY(ds.save());
+    }
+
+    QFile file(journalFile());
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.readAll(), other);
+    file.close();
+
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+    QVERIFY(sameWorkouts(ds.Workouts(), expected));
+}
+
+QTEST_GUILESS_MAIN(TestJournal)
+#include "tst_journal.moc"
@@ -0,0 +1,5 @@
+TARGET = tst_query
+
+include(../tests.pri)
+
+SOURCES += tst_query.cpp
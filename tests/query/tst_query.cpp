@@ -0,0 +1,225 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "datastore.h"
+#include "journal.h"
+#include "testdata.h"
+
+namespace {
+// Rows of a view, in the order walked
+std::vector<int> rows(const WorkoutView &view)
+{
+    std::vector<int> found;
+    WorkoutView::const_iterator i;
+    for (i = view.begin(); i != view.end(); ++i)
+        found.push_back(i.row());
+    return found;
+}
+
+// Every row the query matches, looked at one by one
+std::vector<int> matched(const std::vector<Workout> &workouts, const WorkoutQuery &query)
+{
+    std::vector<int> found;
+    for (size_t row = 0; row < workouts.size(); ++row)
+    {
+        const Workout &w = workouts[row];
+        if (w.start >= query.from && w.start < query.to && query.matches(w))
+            found.push_back(row);
+    }
+    return found;
+}
+} //namespace
+
+class TestQuery : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void views();
+    void setSync();
+    void removeQuery();
+    void removeAtStart();
+
+private:
+    QString csvFile() const { return dir->filePath("data.csv"); }
+
+    QScopedPointer<QTemporaryDir> dir;
+};
+
+void TestQuery::init()
+{
+    dir.reset(new QTemporaryDir);
+    QVERIFY(dir->isValid());
+    QVERIFY(writeFile(csvFile(), sampleCopies(QDate(2009, 12, 1), 20)));
+}
+
+void TestQuery::views()
+{
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+    const std::vector<Workout> &w = ds.Workouts();
+
+    WorkoutQuery all;
+    QCOMPARE(rows(ds.query(all)).size(), w.size());
+
+    WorkoutQuery range;
+    range.from = w[5].start;
+    range.to = w[20].start;
+    QCOMPARE(rows(ds.query(range)), matched(w, range));
+    QCOMPARE(rows(ds.query(range)).size(), size_t(15));
+
+    WorkoutQuery hr = WorkoutQuery::swims();
+    hr.types = 1 << TYPE_SWIMHR;
+    hr.pool = 25;
+    QCOMPARE(rows(ds.query(hr)), matched(w, hr));
+    QCOMPARE(rows(ds.query(hr)).size(), size_t(40));
+
+    WorkoutQuery far = WorkoutQuery::swims();
+    far.distance = 1000;
+    QCOMPARE(rows(ds.query(far)), matched(w, far));
+    QCOMPARE(ds.findSwims(far.from, far.to, far.distance), rows(ds.query(far)));
+
+    // walked in place, the rows are the store's own
+    const WorkoutView view = ds.query(far);
+    QVERIFY(!view.empty());
+    QCOMPARE(&*view.begin(), &w[view.begin().row()]);
+
+    WorkoutQuery none;
+    none.from = none.to = w[3].start;
+    QVERIFY(ds.query(none).empty());
+    none = all;
+    none.pool = 33;
+    QVERIFY(ds.query(none).empty());
+}
+
+void TestQuery::setSync()
+{
+    WorkoutQuery hr;
+    hr.types = 1 << TYPE_SWIMHR;
+
+    std::vector<Workout> expected;
+    {
+        DataStore ds;
+        ds.setFile(csvFile());
+        QVERIFY(ds.load());
+        QVERIFY(ds.save());
+
+        QCOMPARE(ds.setSync(hr, SYNC_STRAVA), 40);
+        WorkoutQuery unsynced = hr;
+        unsynced.syncMask = SYNC_STRAVA;
+        QVERIFY(ds.query(unsynced).empty());
+
+        // only those without the flag change
+        QCOMPARE(ds.setSync(hr, SYNC_STRAVA), 0);
+        WorkoutQuery swims;
+        swims.types = 1 << TYPE_SWIM;
+        QCOMPARE(ds.setSync(swims, SYNC_STRAVA | SYNC_FIT), 20);
+        expected = ds.Workouts();
+    }
+
+    // one journal entry for each call that changed any
+    std::vector<Journal::Entry> entries;
+    QVERIFY(Journal::read(dir->filePath("data.pvd.journal"), 0, entries));
+    QCOMPARE(entries.size(), size_t(2));
+    QCOMPARE(entries[0].op, int(Journal::SYNC));
+    QCOMPARE(entries[0].ids.size(), size_t(40));
+
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+    QVERIFY(sameWorkouts(ds.Workouts(), expected));
+}
+
+void TestQuery::removeQuery()
+{
+    std::vector<Workout> expected;
+    {
+        DataStore ds;
+        ds.setFile(csvFile());
+        QVERIFY(ds.load());
+        QVERIFY(ds.save());
+        const std::vector<Workout> before = ds.Workouts();
+
+        WorkoutQuery hr;
+        hr.types = 1 << TYPE_SWIMHR;
+        hr.from = before[10].start;
+        hr.to = before[40].start;
+        const std::vector<int> gone = matched(before, hr);
+        QCOMPARE(ds.remove(hr), int(gone.size()));
+
+        // the rest kept in order, found by id
+        for (size_t row = 0, g = 0; row < before.size(); ++row)
+        {
+            if (g < gone.size() && gone[g] == (int)row)
+            {
+                QCOMPARE(ds.findWorkout(before[row].id), -1);
+                ++g;
+                continue;
+            }
+            expected.push_back(before[row]);
+            QCOMPARE(ds.findWorkout(before[row].id), int(expected.size() - 1));
+        }
+        QVERIFY(sameWorkouts(ds.Workouts(), expected));
+
+        // nothing matched, nothing logged
+        const qint64 logged = QFile(dir->filePath("data.pvd.journal")).size();
+        QCOMPARE(ds.remove(hr), 0);
+        QCOMPARE(QFile(dir->filePath("data.pvd.journal")).size(), logged);
+    }
+
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+    QVERIFY(sameWorkouts(ds.Workouts(), expected));
+}
+
+void TestQuery::removeAtStart()
+{
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+
+    // a second copy of a swim at the same start
+    const std::vector<std::vector<ExerciseSet> > sessions = readSessions(csvFile());
+    QVERIFY(ds.add(sessions[7]) > 0);
+    std::vector<Workout> expected = ds.Workouts();
+
+    const QDateTime at = startDateTime(sessions[7][0].start);
+    ds.remove(at);
+
+    std::vector<Workout>::iterator i = expected.begin();
+    while (i != expected.end())
+    {
+        if (i->start == sessions[7][0].start)
+            i = expected.erase(i);
+        else
+            ++i;
+    }
+    QCOMPARE(ds.Workouts().size(), size_t(59));
+    QVERIFY(sameWorkouts(ds.Workouts(), expected));
+    QCOMPARE(ds.findExercise(at), -1);
+}
+
+QTEST_GUILESS_MAIN(TestQuery)
+#include "tst_query.moc"
@@ -0,0 +1,5 @@
+TARGET = tst_shards
+
+include(../tests.pri)
+
+SOURCES += tst_shards.cpp
@@ -0,0 +1,173 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "binstore.h"
+#include "datastore.h"
+#include "testdata.h"
+
+class TestShards : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void oneFilePerYear();
+    void singleFileSplit();
+    void loadFrom();
+    void replayNewest();
+    void replayOlder();
+
+private:
+    QString csvFile() const { return dir->filePath("data.csv"); }
+    QString shardFile(int year) const { return dir->filePath(QString("data-%1.pvd").arg(year)); }
+
+    QScopedPointer<QTemporaryDir> dir;
+    std::vector<Workout> all; // as saved by init()
+};
+
+void TestShards::init()
+{
+    dir.reset(new QTemporaryDir);
+    QVERIFY(dir->isValid());
+
+    // two years and most of a third
+    QVERIFY(writeFile(csvFile(), sampleCopies(QDate(2007, 12, 1), 150)));
+
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+    QVERIFY(ds.save());
+    all = ds.Workouts();
+}
+
+void TestShards::oneFilePerYear()
+{
+    QVERIFY(!QFile::exists(dir->filePath("data.pvd")));
+
+    std::vector<Workout> read;
+    for (int year = 2007; year <= 2009; ++year)
+    {
+        const size_t first = read.size();
+        QVERIFY(ReadStore(shardFile(year), read));
+        QVERIFY(read.size() > first);
+        for (size_t i = first; i < read.size(); ++i)
+            QCOMPARE(startDate(read[i].start).year(), year);
+    }
+    QVERIFY(sameWorkouts(read, all));
+}
+
+void TestShards::singleFileSplit()
+{
+    // as written before years were split
+    for (int year = 2007; year <= 2009; ++year)
+        QVERIFY(QFile::remove(shardFile(year)));
+    QVERIFY(SaveStore(dir->filePath("data.pvd"), all, 1));
+
+    {
+        DataStore ds;
+        ds.setFile(csvFile());
+        QVERIFY(ds.load());
+        QVERIFY(ds.hasChanged());
+        QVERIFY(sameWorkouts(ds.Workouts(), all));
+        QVERIFY(ds.save());
+    }
+    QVERIFY(!QFile::exists(dir->filePath("data.pvd")));
+    QVERIFY(QFile::exists(shardFile(2007)));
+
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+    ds.loadAll();
+    QVERIFY(sameWorkouts(ds.Workouts(), all));
+}
+
+void TestShards::loadFrom()
+{
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+
+    // the newest year and the one before
+    QCOMPARE(startDate(ds.Workouts().front().start).year(), 2008);
+    QVERIFY(!ds.loadFrom(QDate(2008, 6, 1)));
+
+    QVERIFY(ds.loadFrom(QDate(2007, 12, 25)));
+    QVERIFY(sameWorkouts(ds.Workouts(), all));
+    QVERIFY(!ds.loadAll());
+    QVERIFY(!ds.hasChanged());
+
+    // an older swim added loads its year first
+    DataStore added;
+    added.setFile(csvFile());
+    QVERIFY(added.load());
+    std::vector<ExerciseSet> session = readSessions(csvFile())[0];
+    for (size_t s = 0; s < session.size(); ++s)
+        session[s].start -= 86400;
+    QVERIFY(added.add(session) > 0);
+    QCOMPARE(added.Workouts().size(), all.size() + 1);
+    QCOMPARE(added.Workouts().front().start, session[0].start);
+}
+
+void TestShards::replayNewest()
+{
+    std::vector<Workout> expected;
+    {
+        DataStore ds;
+        ds.setFile(csvFile());
+        QVERIFY(ds.load());
+        ds.remove(ds.Workouts().back().id);
+        expected = ds.Workouts();
+    }
+
+    // changes in the years read leave the rest on disk
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+    QVERIFY(sameWorkouts(ds.Workouts(), expected));
+}
+
+void TestShards::replayOlder()
+{
+    std::vector<Workout> expected;
+    {
+        DataStore ds;
+        ds.setFile(csvFile());
+        QVERIFY(ds.load());
+        QVERIFY(ds.loadAll());
+
+        Workout changed = ds.Workouts()[1];
+        changed.pool = 33;
+        ds.replaceWorkout(changed.id, changed);
+        ds.remove(ds.Workouts()[0].id);
+        expected = ds.Workouts();
+    }
+
+    // a change to a year not read, every year is read to replay it
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+    QVERIFY(sameWorkouts(ds.Workouts(), expected));
+    QVERIFY(!ds.loadAll());
+}
+
+QTEST_GUILESS_MAIN(TestShards)
+#include "tst_shards.moc"
@@ -0,0 +1,5 @@
+TARGET = tst_snapshot
+
+include(../tests.pri)
+
+SOURCES += tst_snapshot.cpp
@@ -0,0 +1,143 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QTemporaryDir>
+#include <QtConcurrentRun>
+#include <QtTest>
+
+#include "binstore.h"
+#include "datastore.h"
+#include "testdata.h"
+
+namespace {
+// Read on a worker thread while the store changes
+qint64 distance(WorkoutSnapshot snapshot)
+{
+    qint64 total = 0;
+    for (size_t row = 0; row < snapshot.size(); ++row)
+        total += snapshot[row].totaldistance;
+    return total;
+}
+
+// Make one of each kind of change
+void change(DataStore &ds, const std::vector<ExerciseSet> &session)
+{
+    ds.remove(ds.Workouts()[2].id);
+    Workout changed = ds.Workouts()[4];
+    changed.addLength(0, 41000, 12, 0);
+    ds.replaceWorkout(changed.id, changed);
+    ds.removeSet(ds.Workouts()[6].id, 0);
+    ds.addSync(ds.Workouts()[8].id, SYNC_FIT);
+    ds.add(session);
+}
+} //namespace
+
+class TestSnapshot : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void unchanged();
+    void otherThread();
+    void backgroundSave();
+
+private:
+    QString csvFile() const { return dir->filePath("data.csv"); }
+
+    QScopedPointer<QTemporaryDir> dir;
+    std::vector<ExerciseSet> session; // a day after the last
+};
+
+void TestSnapshot::init()
+{
+    dir.reset(new QTemporaryDir);
+    QVERIFY(dir->isValid());
+    QVERIFY(writeFile(csvFile(), sampleCopies(QDate(2009, 12, 1), 20)));
+
+    session = readSessions(csvFile()).back();
+    for (size_t s = 0; s < session.size(); ++s)
+        session[s].start += 86400;
+}
+
+void TestSnapshot::unchanged()
+{
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+
+    const WorkoutSnapshot snapshot = ds.snapshot();
+    const std::vector<Workout> taken = ds.Workouts();
+    QCOMPARE(&snapshot[0], &ds.Workouts()[0]);
+
+    // the store copies its rows rather than change the snapshot's
+    change(ds, session);
+    QVERIFY(sameWorkouts(snapshot.workouts(), taken));
+    QVERIFY(!sameWorkouts(ds.Workouts(), taken));
+
+    // and a later one sees the changes
+    QVERIFY(sameWorkouts(ds.snapshot().workouts(), ds.Workouts()));
+    QCOMPARE(&*snapshot.query(WorkoutQuery::swims()).begin(), &snapshot[0]);
+}
+
+void TestSnapshot::otherThread()
+{
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+
+    const WorkoutSnapshot snapshot = ds.snapshot();
+    const qint64 total = distance(snapshot);
+    QFuture<qint64> read = QtConcurrent::run(distance, snapshot);
+    change(ds, session);
+    QCOMPARE(read.result(), total);
+}
+
+void TestSnapshot::backgroundSave()
+{
+    std::vector<Workout> saved, expected;
+    {
+        DataStore ds;
+        ds.setFile(csvFile());
+        QVERIFY(ds.load());
+        QVERIFY(ds.save());
+
+        // written from a snapshot while the changes carry on
+        ds.remove(ds.Workouts()[0].id);
+        ds.setChanged();
+        ds.autosave();
+        saved = ds.Workouts();
+        change(ds, session);
+        expected = ds.Workouts();
+    }
+
+    // the data files hold the rows as they were, the journal the rest
+    std::vector<Workout> read;
+    QVERIFY(ReadStore(dir->filePath("data-2009.pvd"), read));
+    QVERIFY(ReadStore(dir->filePath("data-2010.pvd"), read));
+    QVERIFY(sameWorkouts(read, saved));
+
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+    QVERIFY(sameWorkouts(ds.Workouts(), expected));
+}
+
+QTEST_GUILESS_MAIN(TestSnapshot)
+#include "tst_snapshot.moc"
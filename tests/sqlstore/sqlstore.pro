@@ -0,0 +1,5 @@
+TARGET = tst_sqlstore
+
+include(../tests.pri)
+
+SOURCES += tst_sqlstore.cpp
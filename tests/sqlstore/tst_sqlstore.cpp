@@ -0,0 +1,212 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "datastore.h"
+#include "sqlstore.h"
+#include "testdata.h"
+
+class TestSqlStore : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void roundTrip();
+    void settingOnOff();
+    void readByYear();
+
+private:
+    QString csvFile() const { return dir->filePath("data.csv"); }
+    QString databaseFile() const { return dir->filePath("data.sqlite"); }
+
+    // Everything in the database, in start order
+    std::vector<Workout> stored();
+
+    QScopedPointer<QTemporaryDir> dir;
+};
+
+void TestSqlStore::init()
+{
+    dir.reset(new QTemporaryDir);
+    QVERIFY(dir->isValid());
+
+    // two years and most of a third
+    QVERIFY(writeFile(csvFile(), sampleCopies(QDate(2007, 12, 1), 150)));
+}
+
+std::vector<Workout> TestSqlStore::stored()
+{
+    std::vector<Workout> rows;
+    SqlStore database;
+    if (database.open(databaseFile()))
+        database.read(rows, NO_START, std::numeric_limits<qint64>::max());
+    return rows;
+}
+
+void TestSqlStore::roundTrip()
+{
+    QVERIFY(writeFile(csvFile(), sample_csv));
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+    std::vector<Workout> rows = ds.Workouts();
+
+    {
+        SqlStore database;
+        QVERIFY(database.open(databaseFile()));
+        QVERIFY(database.isEmpty());
+        QCOMPARE(database.sequence(), quint64(0));
+
+        SqlStore::Ranges all;
+        all << qMakePair(NO_START, std::numeric_limits<qint64>::max());
+        QVERIFY(database.write(rows, all, 7));
+    }
+
+    SqlStore database;
+    QVERIFY(database.open(databaseFile()));
+    QVERIFY(!database.isEmpty());
+    QCOMPARE(database.sequence(), quint64(7));
+    QCOMPARE(database.lastStart(), rows.back().start);
+
+    std::vector<Workout> read;
+    QVERIFY(database.read(read, NO_START, std::numeric_limits<qint64>::max()));
+    QVERIFY(sameWorkouts(read, rows));
+
+    // only the range asked for
+    read.clear();
+    QVERIFY(database.read(read, rows[1].start, rows[2].start));
+    QCOMPARE(read.size(), size_t(1));
+    QVERIFY(sameWorkout(read[0], rows[1]));
+
+    // a range written again loses what is no longer in it
+    SqlStore::Ranges day;
+    day << qMakePair(rows[1].start, rows[2].start);
+    rows.erase(rows.begin() + 1);
+    rows[0].pool = 33;
+    QVERIFY(database.write(rows, day, 8));
+    QCOMPARE(database.sequence(), quint64(8));
+
+    read.clear();
+    QVERIFY(database.read(read, NO_START, std::numeric_limits<qint64>::max()));
+    QCOMPARE(read.size(), size_t(2));
+    QCOMPARE(read[0].pool, 50);
+    QVERIFY(sameWorkout(read[1], rows[1]));
+}
+
+void TestSqlStore::settingOnOff()
+{
+    std::vector<Workout> expected;
+    {
+        // filled from the csv file in the background
+        DataStore ds;
+        ds.setFile(csvFile());
+        ds.setDatabase(true);
+        QVERIFY(ds.load());
+        expected = ds.Workouts();
+    }
+    QVERIFY(sameWorkouts(stored(), expected));
+
+    {
+        // changes reach it with the data files
+        DataStore ds;
+        ds.setFile(csvFile());
+        ds.setDatabase(true);
+        QVERIFY(ds.load());
+        ds.loadAll();
+        ds.remove(ds.Workouts().back().id);
+        ds.autosave();
+        expected = ds.Workouts();
+    }
+    QVERIFY(sameWorkouts(stored(), expected));
+
+    {
+        // turned off it is left as it was
+        DataStore ds;
+        ds.setFile(csvFile());
+        QVERIFY(ds.load());
+        ds.loadAll();
+        ds.remove(ds.Workouts().back().id);
+        ds.setChanged();
+        QVERIFY(ds.save());
+    }
+    QVERIFY(QFile::exists(databaseFile()));
+    QVERIFY(sameWorkouts(stored(), expected));
+    expected.pop_back();
+
+    {
+        // and filled again from the data files once back on
+        DataStore ds;
+        ds.setFile(csvFile());
+        ds.setDatabase(true);
+        QVERIFY(ds.load());
+        ds.loadAll();
+        QVERIFY(sameWorkouts(ds.Workouts(), expected));
+    }
+    QVERIFY(sameWorkouts(stored(), expected));
+}
+
+void TestSqlStore::readByYear()
+{
+    std::vector<Workout> expected;
+    {
+        DataStore ds;
+        ds.setFile(csvFile());
+        ds.setDatabase(true);
+        QVERIFY(ds.load());
+        expected = ds.Workouts();
+    }
+
+    {
+        // the newest two years, the first when asked for
+        DataStore ds;
+        ds.setFile(csvFile());
+        ds.setDatabase(true);
+        QVERIFY(ds.load());
+        QVERIFY(!ds.hasChanged());
+        QCOMPARE(startDate(ds.Workouts().front().start), QDate(2008, 1, 1));
+        QVERIFY(ds.loadFrom(QDate(2007, 12, 25)));
+        QVERIFY(sameWorkouts(ds.Workouts(), expected));
+    }
+
+    // read from the database alone, the data files written again from it
+    for (int year = 2007; year <= 2009; ++year)
+        QVERIFY(QFile::remove(dir->filePath(QString("data-%1.pvd").arg(year))));
+    {
+        DataStore ds;
+        ds.setFile(csvFile());
+        ds.setDatabase(true);
+        QVERIFY(ds.load());
+        QVERIFY(ds.hasChanged());
+        QVERIFY(sameWorkouts(ds.Workouts(), expected));
+        QVERIFY(ds.save());
+    }
+    QVERIFY(QFile::exists(dir->filePath("data-2007.pvd")));
+
+    DataStore ds;
+    ds.setFile(csvFile());
+    QVERIFY(ds.load());
+    QVERIFY(ds.loadAll());
+    QVERIFY(sameWorkouts(ds.Workouts(), expected));
+}
+
+QTEST_GUILESS_MAIN(TestSqlStore)
+#include "tst_sqlstore.moc"
@@ -0,0 +1,134 @@
+/*
+ * This file is part of PoolViewer
+ * Copyright (c) 2011-2015 Ivor Hewitt
+ *
+ * PoolViewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * PoolViewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PoolViewer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TESTDATA_H
+#define TESTDATA_H
+
+#include <QDate>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+
+#include "datastore.h"
+
+// A swim without lengths and two with, as the poolmate software writes them
+const char sample_csv[] =
+    "User Number,Date,Time,Type,Pool Length,,Duration,Calories,Total Laps,Total Distance,"
+    "Set Number,Set Duration,Average Strokes,Distance,Speed,Efficiency,Stroke Rate,,,,,,"
+    "Watch Version,Status,Notes\n"
+    "1,2/1/2010,07:16:07,Swim,50,,00:24:40,192,59,2950,1,00:08:37,9,20,192,47,18,Free,,,,,210,,,\n"
+    "1,2/1/2010,07:16:07,Swim,50,,00:24:40,444,59,2950,2,00:00:53,9,9,100,57,10,Free,,,,,210,,,\n"
+    "1,3/1/2010,10:16:33,SwimHR,25,,00:05:00,50,6,150,1,00:02:00,12,3,133,44,22,Free,,,,,0,New,"
+    "00:05:00,,STARTOFLAPDATA,0,0,0,100.000,00:20,SwimHR,2,-1,40.5,12,39.25,12,41,13\n"
+    "1,3/1/2010,10:16:33,SwimHR,25,,00:05:00,50,6,150,2,00:02:10,13,3,144,46,22,Free,,,,,0,New,"
+    "00:05:00,,STARTOFLAPDATA,0,0,0,100.000,,SwimHR,2,-1,43.5,13,42.25,13,44,13\n"
+    "1,5/1/2010,18:02:10,SwimHR,25,,00:03:00,30,4,100,1,00:01:20,14,2,160,50,21,Free,,,,,0,New,"
+    "00:03:00,,STARTOFLAPDATA,0,0,0,100.000,00:10,SwimHR,1,-1,40,14,40.5,14\n"
+    "1,5/1/2010,18:02:10,SwimHR,25,,00:03:00,30,4,100,2,00:01:30,15,2,180,52,21,Free,,,,,0,New,"
+    "00:03:00,,STARTOFLAPDATA,0,0,0,100.000,,SwimHR,1,-1,44.75,15,45,15\n";
+
+// sample_csv count times over, each copy four days after the one before
+inline QByteArray sampleCopies(const QDate &first, int count)
+{
+    const QStringList lines = QString(sample_csv).split('\n');
+    const QDate sampled(2010, 1, 2);
+
+    QString csv = lines[0] + '\n';
+    for (int c = 0; c < count; ++c)
+    {
+        for (int l = 1; l < lines.size(); ++l)
+        {
+            if (lines[l].isEmpty())
+                continue;
+            QStringList fields = lines[l].split(',');
+            const int day = sampled.daysTo(QDate::fromString(fields[1], "d/M/yyyy"));
+            fields[1] = first.addDays(4*c + day).toString("d/M/yyyy");
+            csv += fields.join(',') + '\n';
+        }
+    }
+    return csv.toLatin1();
+}
+
+inline bool writeFile(const QString &name, const QByteArray &data)
+{
+    QFile file(name);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+// Every field kept in the data file, ids too unless told not to
+inline bool sameWorkout(const Workout &a, const Workout &b, bool ids = true)
+{
+    if ((ids && a.id != b.id) || a.sync != b.sync || a.user != b.user ||
+        a.start != b.start || a.type != b.type || a.pool != b.pool ||
+        a.unit != b.unit || a.totalduration != b.totalduration || a.rest != b.rest ||
+        a.cal != b.cal || a.lengths != b.lengths || a.totaldistance != b.totaldistance ||
+        a.sets.size() != b.sets.size())
+        return false;
+
+    for (size_t s = 0; s < a.sets.size(); ++s)
+    {
+        const Set &x = a.sets[s];
+        const Set &y = b.sets[s];
+        if (x.set != y.set || x.duration != y.duration || x.lens != y.lens ||
+            x.strk != y.strk || x.dist != y.dist || x.speed != y.speed ||
+            x.effic != y.effic || x.rate != y.rate || x.rest != y.rest ||
+            x.count != y.count)
+            return false;
+
+        for (int l = 0; l < x.count; ++l)
+        {
+            if (a.lengthMsecs(x, l) != b.lengthMsecs(y, l) ||
+                a.lengthStrokes(x, l) != b.lengthStrokes(y, l) ||
+                a.lengthStyle(x, l) != b.lengthStyle(y, l))
+                return false;
+        }
+    }
+    return true;
+}
+
+inline bool sameWorkouts(const std::vector<Workout> &a, const std::vector<Workout> &b, bool ids = true)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (!sameWorkout(a[i], b[i], ids))
+            return false;
+    }
+    return true;
+}
+
+// Sessions of a csv file as read for import, one per start
+inline std::vector<std::vector<ExerciseSet> > readSessions(const QString &file)
+{
+    std::vector<ExerciseSet> sets;
+    std::vector<std::vector<ExerciseSet> > sessions;
+    if (!ReadCSV(file.toStdString(), sets, 1))
+        return sessions;
+
+    std::vector<ExerciseSet>::const_iterator i;
+    for (i = sets.begin(); i != sets.end(); ++i)
+    {
+        if (sessions.empty() || sessions.back().front().start != i->start)
+            sessions.push_back(std::vector<ExerciseSet>());
+        sessions.back().push_back(*i);
+    }
+    return sessions;
+}
+
+#endif
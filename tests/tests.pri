@@ -0,0 +1,25 @@
+# Shared by each test program, built against the data store sources
+QT = core concurrent sql testlib
+
+CONFIG += qt warn_on console testcase
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD $$PWD/../src
+
+HEADERS = $$PWD/testdata.h \
+    $$PWD/../src/datastore.h \
+    $$PWD/../src/aggregates.h \
+    $$PWD/../src/backup.h \
+    $$PWD/../src/binstore.h \
+    $$PWD/../src/journal.h \
+    $$PWD/../src/sqlstore.h \
+    $$PWD/../src/vocabulary.h \
+    $$PWD/../src/exerciseset.h
+SOURCES = $$PWD/../src/datastore.cpp \
+    $$PWD/../src/aggregates.cpp \
+    $$PWD/../src/backup.cpp \
+    $$PWD/../src/binstore.cpp \
+    $$PWD/../src/journal.cpp \
+    $$PWD/../src/sqlstore.cpp \
+    $$PWD/../src/vocabulary.cpp \
+    $$PWD/../src/fitwriter.cpp
@@ -0,0 +1,13 @@
+TEMPLATE = subdirs
+
+# one test program per part of the data store, run with make check
+SUBDIRS = binstore \
+    journal \
+    csv \
+    fingerprint \
+    sqlstore \
+    backup \
+    shards \
+    aggregates \
+    query \
+    snapshot